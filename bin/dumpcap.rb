@@ -3,6 +3,10 @@ require 'logger'
 require 'rcapdissector'
 require 'pp'
 
+# A WLAN tag containing the SSID is an interpretation whose sibling tag number is 0
+SSID_TAG_QUERY = CapDissector::FieldQuery.compile(:name => "wlan_mgt.tag.interpretation",
+                                                  :sibling => {:name => "wlan_mgt.tag.number", :value => [0]})
+
 # Define 'WiresharkPref' as an option type, consisting of a name=value pair
 class WiresharkPref
     attr_reader :name
@@ -173,13 +177,7 @@ def main(*args)
     
         if opts[:list_wireless_aps]
             # Look for a WLAN tag containing the SSID
-            ssid_tag = packet.find_first_field_match(Proc.new {|query|
-                query.name_is?("wlan_mgt.tag.interpretation") &&
-                query.sibling_matches?(Proc.new {|sib_query|
-                    sib_query.name_is?("wlan_mgt.tag.number") &&
-                    sib_query.value_is?([0])
-                })
-            })
+            ssid_tag = packet.find_first_field_match(SSID_TAG_QUERY)
         
             if ssid_tag != nil
                 wlan_aps[ssid_tag.display_value] = 0 if wlan_aps[ssid_tag.display_value] == nil
@@ -1,13 +0,0 @@
-#include "Allocator.h"
-
-#ifdef USE_LOOKASIDE_LIST
-
-Allocator::Allocator(void)
-{
-}
-
-Allocator::~Allocator(void)
-{
-}
-
-#endif
@@ -5,18 +5,28 @@
 #include <epan/prefs.h>
 
 #include "NativePacket.h"
-
-static gint cols[] = {
-    COL_NUMBER,
-    COL_DEF_SRC,
-    COL_DEF_DST,
-    COL_PROTOCOL,
-    COL_INFO,
-    COL_CLS_TIME
+#include "MappedPcapRecordReader.h"
+#include "PrefetchRecordReader.h"
+#include "FileWatcher.h"
+#include "MergingRecordReader.h"
+
+/** The columns set up when columns= hasn't been called, and the names by which columns= and Packet#column
+ *  know them */
+static const struct {
+	const char* name;
+	gint format;
+} DEFAULT_COLUMNS[] = {
+    { "number", COL_NUMBER },
+    { "source_address", COL_DEF_SRC },
+    { "destination_address", COL_DEF_DST },
+    { "protocol", COL_PROTOCOL },
+    { "info", COL_INFO },
+    { "timestamp", COL_CLS_TIME }
 };
 
-gint* CapFile::COLUMNS = cols;
-gint CapFile::NUM_COLUMNS = sizeof(cols) / sizeof(cols[0]);
+#define NUM_DEFAULT_COLUMNS (sizeof(DEFAULT_COLUMNS) / sizeof(DEFAULT_COLUMNS[0]))
+
+long CapFile::READ_AHEAD_DEPTH = DEFAULT_READ_AHEAD_DEPTH;
 
 /** copied from Wireshark, epan\dissectors\packet-ieee80211.c */
 #define MAX_ENCRYPTION_KEYS 64
@@ -168,15 +178,66 @@ VALUE CapFile::createClass() {
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_wlan_decryption_keys), 
 					 1);
 
+    rb_define_singleton_method(klass,
+                     "set_read_ahead_depth", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_read_ahead_depth), 
+					 1);
+
     rb_define_method(klass,
                      "set_display_filter", 
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_display_filter), 
+					 -1);
+
+    rb_define_method(klass,
+                     "set_capture_filter", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_capture_filter), 
+					 1);
+
+    rb_define_method(klass,
+                     "interested_fields=", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_interested_fields), 
+					 1);
+
+    rb_define_method(klass,
+                     "columns=", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_columns), 
+					 1);
+
+    rb_define_method(klass,
+                     "save_frame_index=", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_save_frame_index), 
 					 1);
 
+    rb_define_method(klass,
+                     "set_checkpoint_file", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::set_checkpoint_file), 
+					 -1);
+
     //Define the 'each_packet' method
     rb_define_method(klass,
                      "each_packet", 
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::each_packet), 
+					 -1);
+
+    rb_define_method(klass,
+                     "packet_at", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::packet_at), 
+					 1);
+
+    //Define the 'each_packet_batch' method
+    rb_define_method(klass,
+                     "each_packet_batch", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::each_packet_batch), 
+					 -1);
+
+    rb_define_method(klass,
+                     "memory_mapped?", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::is_memory_mapped), 
+					 0);
+
+    rb_define_method(klass,
+                     "dissection_context_stats", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::dissection_context_stats), 
 					 0);
 
     //Define the 'close' method
@@ -196,6 +257,12 @@ VALUE CapFile::createClass() {
                    TRUE, 
                    FALSE);
 
+    //Define the 'interested_fields' attribute reader; the writer is interested_fields= above
+    rb_define_attr(klass,
+                   "interested_fields",
+                   TRUE, 
+                   FALSE);
+
 	//Define some const values for useful TCP prefs
 	::rb_define_const(klass, "PREF_TCP_SHOW_SUMMARY", ::rb_str_new2("tcp.summary_in_tree"));
 	::rb_define_const(klass, "PREF_TCP_CHECK_CHECKSUM", ::rb_str_new2("tcp.check_checksum"));
@@ -210,6 +277,10 @@ VALUE CapFile::createClass() {
 	::rb_define_const(klass, "PREF_HTTP_DECHUNK_BODY", ::rb_str_new2("http.dechunk_body"));
 	::rb_define_const(klass, "PREF_HTTP_DECOMPRESS_BODY", ::rb_str_new2("http.decompress_body"));
 
+	::rb_define_const(klass, "DEFAULT_PACKET_BATCH_SIZE", LONG2FIX(DEFAULT_PACKET_BATCH_SIZE));
+	::rb_define_const(klass, "DEFAULT_READ_AHEAD_DEPTH", LONG2FIX(DEFAULT_READ_AHEAD_DEPTH));
+	::rb_define_const(klass, "DEFAULT_CHECKPOINT_INTERVAL", LONG2FIX(DEFAULT_CHECKPOINT_INTERVAL));
+
 	//Initialize some prefs to reasonable defaults
 	setPreference("tcp.summary_in_tree", "true");
 	setPreference("tcp.check_checksum", "false");
@@ -221,7 +292,30 @@ VALUE CapFile::createClass() {
 	return klass;
 }
 
+VALUE CapFile::createSetClass() {
+    //Define the 'CapFileSet' class.  Everything but the constructor is inherited from CapFile
+	VALUE klass = rb_define_class_under(g_cap_dissector_module, "CapFileSet", g_cap_file_class);
+
+    rb_define_method(klass,
+                     "initialize", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CapFile::initialize_set), 
+					 1);
+
+    //Define the 'capture_files' attribute reader
+    rb_define_attr(klass,
+                   "capture_files",
+                   TRUE, 
+                   FALSE);
+
+	return klass;
+}
+
 void CapFile::initPacketCapture() {
+	//Records are read ahead on a background thread, so glib needs to be thread-aware
+	if (!g_thread_supported()) {
+		g_thread_init(NULL);
+	}
+
   /*
    * Get credential information for later use.
    */
@@ -242,17 +336,35 @@ void CapFile::deinitPacketCapture() {
 }
 
 CapFile::CapFile(void)
-#ifdef USE_LOOKASIDE_LIST
-	//These initial/max numbers are derived imperically; typical wlan captures contain no more than 187 fields
-	//so these numbers should minimize heap operations while also keeping memory consumption at the low end
-	: _nodeLookaside(_allocator, 200, 500)
-#endif
 {
 	::memset(&_cf, 0, sizeof(_cf));
+	_reader = NULL;
+	_memoryMapped = FALSE;
+	_isSet = FALSE;
+	_filterFirst = FALSE;
+	_frameIndex = NULL;
+	_saveFrameIndex = FALSE;
+	_dissectPool = new EpanDissectPool();
+
+	for (size_t idx = 0; idx < NUM_DEFAULT_COLUMNS; idx++) {
+		_columnFormats.push_back(DEFAULT_COLUMNS[idx].format);
+		_columnFields.push_back(std::string());
+	}
+	_randomWth = NULL;
+	_position.cumBytes = 0;
+	_position.lastRecordOffset = -1;
+	_checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL;
+	_lastCheckpointFrame = 0;
+#ifdef HAVE_LIBPCAP
+	_captureFilter = NULL;
+#endif
 }
 
 CapFile::~CapFile(void) {
 	closeCaptureFile();
+
+	_dissectPool->removeRef();
+	_dissectPool = NULL;
 }
 
 const char* CapFile::buildCfOpenErrorMessage(int err, 
@@ -384,6 +496,23 @@ VALUE CapFile::initialize(VALUE self, VALUE capfile) {
     return self;
 }
 
+VALUE CapFile::initialize_set(VALUE self, VALUE capfiles) {
+	CapFile* cf = NULL;
+
+	VALUE paths = expandCaptureFileSet(capfiles);
+
+    //Save off what we were given, and what it expanded to
+    rb_iv_set(self, "@capture_file", capfiles);
+    rb_iv_set(self, "@capture_files", paths);
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	cf->_self = self;
+	cf->openCaptureFileSet(capfiles, paths);
+
+    return self;
+}
+
 VALUE CapFile::init_copy(VALUE copy, VALUE orig) {
 	//Copy this object to a new one.  Open the cap file again
 	CapFile* cfCopy = NULL;
@@ -432,24 +561,201 @@ VALUE CapFile::set_wlan_decryption_keys(VALUE, VALUE keys) {
 	return Qnil;
 }
 
-VALUE CapFile::set_display_filter(VALUE self, VALUE filter) {
+VALUE CapFile::set_read_ahead_depth(VALUE, VALUE depth) {
+	long newDepth = NUM2LONG(depth);
+	if (newDepth < 0) {
+		::rb_raise(::rb_eArgError, "The read-ahead depth cannot be negative");
+	}
+
+	//Takes effect for capture files opened from now on
+	READ_AHEAD_DEPTH = newDepth;
+	return Qnil;
+}
+
+VALUE CapFile::set_display_filter(int argc, VALUE* argv, VALUE self) {
+	CapFile* cf = NULL;
+
+	//set_display_filter takes a filter and an optional hash of options
+	if (argc < 1 || argc > 2) {
+		::rb_raise(::rb_eArgError, "set_display_filter expects 1 or 2 args");
+	}
+
+	VALUE filterFirst = Qnil;
+	if (argc == 2 && !NIL_P(argv[1])) {
+		Check_Type(argv[1], T_HASH);
+		filterFirst = ::rb_hash_aref(argv[1], ID2SYM(::rb_intern("filter_first")));
+	}
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	cf->setDisplayFilter(argv[0], RTEST(filterFirst));
+	return self;
+}
+
+VALUE CapFile::set_capture_filter(VALUE self, VALUE filter) {
+	CapFile* cf = NULL;
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	cf->setCaptureFilter(filter);
+	return self;
+}
+
+VALUE CapFile::set_save_frame_index(VALUE self, VALUE save) {
+	CapFile* cf = NULL;
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	cf->setSaveFrameIndex(RTEST(save) ? TRUE : FALSE);
+	return save;
+}
+
+VALUE CapFile::set_interested_fields(VALUE self, VALUE names) {
 	CapFile* cf = NULL;
 
 	Data_Get_Struct(self, CapFile, cf);
 
-	cf->setDisplayFilter(filter);
+	cf->setInterestedFields(names);
+	rb_iv_set(self, "@interested_fields", names);
+	return names;
+}
+
+VALUE CapFile::set_columns(VALUE self, VALUE columns) {
+	CapFile* cf = NULL;
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	cf->setColumns(columns);
+	return columns;
+}
+
+VALUE CapFile::set_checkpoint_file(int argc, VALUE* argv, VALUE self) {
+	CapFile* cf = NULL;
+
+	//set_checkpoint_file takes a path and an optional interval
+	if (argc < 1 || argc > 2) {
+		::rb_raise(::rb_eArgError, "set_checkpoint_file expects 1 or 2 args");
+	}
+
+	long interval = DEFAULT_CHECKPOINT_INTERVAL;
+	if (argc == 2 && !NIL_P(argv[1])) {
+		interval = NUM2LONG(argv[1]);
+		if (interval < 1) {
+			::rb_raise(::rb_eArgError, "The checkpoint interval must be at least 1");
+		}
+	}
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	cf->setCheckpointFile(argv[0], interval);
+	return self;
+}
+
+VALUE CapFile::each_packet(int argc, VALUE* argv, VALUE self) {
+	CapFile* cf = NULL;
+
+	//each_packet takes an optional hash of options
+	if (argc < 0 || argc > 1) {
+		::rb_raise(::rb_eArgError, "each_packet expects 0 or 1 args");
+	}
+
+	VALUE range = Qnil;
+	VALUE from = Qnil;
+	VALUE to = Qnil;
+	VALUE warmUp = Qnil;
+	VALUE follow = Qnil;
+	VALUE idleTimeout = Qnil;
+	if (argc == 1 && !NIL_P(argv[0])) {
+		Check_Type(argv[0], T_HASH);
+		range = ::rb_hash_aref(argv[0], ID2SYM(::rb_intern("range")));
+		from = ::rb_hash_aref(argv[0], ID2SYM(::rb_intern("from")));
+		to = ::rb_hash_aref(argv[0], ID2SYM(::rb_intern("to")));
+		warmUp = ::rb_hash_aref(argv[0], ID2SYM(::rb_intern("warm_up")));
+		follow = ::rb_hash_aref(argv[0], ID2SYM(::rb_intern("follow")));
+		idleTimeout = ::rb_hash_aref(argv[0], ID2SYM(::rb_intern("idle_timeout")));
+	}
+
+	bool timeRange = !NIL_P(from) || !NIL_P(to);
+	if (!NIL_P(range) && timeRange) {
+		::rb_raise(::rb_eArgError, "each_packet accepts either a :range of frame numbers or :from/:to times, not both");
+	}
+
+	if (RTEST(follow) && (!NIL_P(range) || timeRange)) {
+		::rb_raise(::rb_eArgError, "each_packet can't :follow a capture file and also read a :range or :from/:to times");
+	}
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	if (RTEST(follow)) {
+		cf->eachPacketFollowing(idleTimeout);
+	} else if (timeRange) {
+		cf->eachPacketInTimeRange(from, to, warmUp);
+	} else if (!NIL_P(range)) {
+		cf->eachPacketInRange(range);
+	} else {
+		cf->eachPacket();
+	}
 	return self;
 }
 
-VALUE CapFile::each_packet(VALUE self) {
+VALUE CapFile::packet_at(VALUE self, VALUE frameNumber) {
+	CapFile* cf = NULL;
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	VALUE packet = cf->packetAt(NUM2LONG(frameNumber));
+
+	//The packet outlives the next dissection, which reuses the column buffers its columns are
+	//formatted in, so copy them out now as each_packet_batch does
+	if (!NIL_P(packet)) {
+		Packet::snapshotPacketColumns(packet);
+	}
+
+	return packet;
+}
+
+VALUE CapFile::each_packet_batch(int argc, VALUE* argv, VALUE self) {
 	CapFile* cf = NULL;
 
+	//each_packet_batch takes an optional batch size
+	if (argc < 0 || argc > 1) {
+		::rb_raise(::rb_eArgError, "each_packet_batch expects 0 or 1 args");
+	}
+
+	long batchSize = DEFAULT_PACKET_BATCH_SIZE;
+	if (argc == 1 && !NIL_P(argv[0])) {
+		batchSize = NUM2LONG(argv[0]);
+		if (batchSize < 1) {
+			::rb_raise(::rb_eArgError, "The batch size must be at least 1");
+		}
+	}
+
 	Data_Get_Struct(self, CapFile, cf);
 
-	cf->eachPacket();
+	cf->eachPacketBatch(batchSize);
 	return self;
 }
 
+VALUE CapFile::is_memory_mapped(VALUE self) {
+	CapFile* cf = NULL;
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	return cf->_memoryMapped ? Qtrue : Qfalse;
+}
+
+VALUE CapFile::dissection_context_stats(VALUE self) {
+	CapFile* cf = NULL;
+
+	Data_Get_Struct(self, CapFile, cf);
+
+	//How many dissections have been run, and how many of them needed a newly-allocated context
+	VALUE stats = ::rb_hash_new();
+	::rb_hash_aset(stats, ID2SYM(::rb_intern("acquired")), ULL2NUM(cf->_dissectPool->getAcquisitionCount()));
+	::rb_hash_aset(stats, ID2SYM(::rb_intern("allocated")), ULL2NUM(cf->_dissectPool->getAllocationCount()));
+	return stats;
+}
+
 VALUE CapFile::close_capture_file(VALUE self) {
 	CapFile* cf = NULL;
 
@@ -508,6 +814,26 @@ void CapFile::openCaptureFile(VALUE capFileName) {
         _cf.has_snap = TRUE;
     nstime_set_zero(&_cf.elapsed_time);
 
+    //Plain pcap files can be read straight out of a memory mapping; everything else
+    //goes through wiretap
+    _reader = MappedPcapRecordReader::open(name, _cf.wth);
+    if (_reader) {
+        _memoryMapped = TRUE;
+    } else {
+        _reader = new WtapRecordReader(_cf.wth);
+        _memoryMapped = FALSE;
+
+        //Overlap wiretap's I/O with dissection.  Mapped files don't need this; the kernel
+        //reads ahead of a sequential mapping on its own
+        if (READ_AHEAD_DEPTH > 0) {
+            _reader = new PrefetchRecordReader(_reader, static_cast<size_t>(READ_AHEAD_DEPTH));
+        }
+    }
+
+    //Use the index left by an earlier run if it's still current.  Otherwise there's no index until
+    //random access needs one, or save_frame_index= asks for one to be built and kept
+    _frameIndex = FrameIndex::load(name);
+
     setupColumns();
 
     return;
@@ -519,7 +845,146 @@ void CapFile::openCaptureFile(VALUE capFileName) {
     rb_raise(g_wtapcapfile_error_class, err_msg, err);
 }
 
+void CapFile::openCaptureFileSet(VALUE capFileNames, VALUE paths) {
+	//Apply any previously-set preferences
+	prefs_apply_all();
+
+	if (RARRAY(paths)->len == 0) {
+		VALUE description = ::rb_inspect(capFileNames);
+		::rb_raise(g_capfile_error_class, 
+			"No capture files found in %s", 
+			RSTRING(description)->ptr);
+	}
+
+	MergingRecordReader* merger = new MergingRecordReader();
+
+	for (long idx = 0; idx < RARRAY(paths)->len; idx++) {
+		const char* name = RSTRING(RARRAY(paths)->ptr[idx])->ptr;
+
+		wtap* wth;
+		gchar* err_info;
+		char err_msg[2048+1];
+		int err;
+
+		wth = wtap_open_offline(name, &err, &err_info, FALSE);
+		if (wth == NULL) {
+			//Closes the files opened so far
+			delete merger;
+
+			g_snprintf(err_msg, 
+				sizeof err_msg,
+				buildCfOpenErrorMessage(err, err_info, FALSE, 0), name);
+			rb_raise(g_wtapcapfile_error_class, err_msg, err);
+		}
+
+		//Each file gets the same kind of reader it would have on its own
+		RecordReader* reader = MappedPcapRecordReader::open(name, wth);
+		if (!reader) {
+			reader = new WtapRecordReader(wth);
+			if (READ_AHEAD_DEPTH > 0) {
+				reader = new PrefetchRecordReader(reader, static_cast<size_t>(READ_AHEAD_DEPTH));
+			}
+		}
+
+		merger->addMember(name, wth, reader);
+	}
+
+	//There's no single wiretap handle for the set; the members own theirs
+	_cf.wth = NULL;
+	_cf.f_datalen = 0;
+	_cf.filename = g_strdup(RSTRING(::rb_inspect(capFileNames))->ptr);
+	_cf.is_tempfile = FALSE;
+	_cf.user_saved = TRUE;
+	_cf.cd_t = static_cast<guint16>(wtap_file_type(merger->getFirstWth()));
+	_cf.count = 0;
+	_cf.drops_known = FALSE;
+	_cf.drops = 0;
+	_cf.has_snap = FALSE;
+	_cf.snap = WTAP_MAX_PACKET_SIZE;
+	nstime_set_zero(&_cf.elapsed_time);
+
+	_reader = merger;
+	_memoryMapped = FALSE;
+	_isSet = TRUE;
+
+	setupColumns();
+}
+
+VALUE CapFile::expandCaptureFileSet(VALUE capFileNames) {
+	VALUE paths;
+
+	if (TYPE(capFileNames) == T_ARRAY) {
+		//Explicit lists are taken in the order given
+		paths = ::rb_ary_new2(RARRAY(capFileNames)->len);
+		for (long idx = 0; idx < RARRAY(capFileNames)->len; idx++) {
+			VALUE path = RARRAY(capFileNames)->ptr[idx];
+			SafeStringValue(path);
+			::rb_ary_push(paths, path);
+		}
+
+		return paths;
+	}
+
+	SafeStringValue(capFileNames);
+
+	//A directory means every file in it; anything else is taken as a glob pattern
+	VALUE pattern = capFileNames;
+	if (RTEST(::rb_funcall(::rb_cFile, ::rb_intern("directory?"), 1, capFileNames))) {
+		pattern = ::rb_funcall(::rb_cFile, ::rb_intern("join"), 2, capFileNames, ::rb_str_new2("*"));
+	}
+
+	VALUE matches = ::rb_funcall(::rb_cDir, ::rb_intern("glob"), 1, pattern);
+
+	//Ring buffer files sort into the order they were written
+	matches = ::rb_funcall(matches, ::rb_intern("sort"), 0);
+
+	paths = ::rb_ary_new2(RARRAY(matches)->len);
+	for (long idx = 0; idx < RARRAY(matches)->len; idx++) {
+		VALUE path = RARRAY(matches)->ptr[idx];
+
+		//Skip subdirectories, and this library's own index and checkpoint files, including the temporary
+		//files they're written to.  A checkpoint's temporary file that's still empty, mid-write, isn't
+		//recognizable yet, and is taken as a capture file
+		if (!RTEST(::rb_funcall(::rb_cFile, ::rb_intern("file?"), 1, path))) {
+			continue;
+		}
+
+		if (FrameIndex::isSidecarPath(RSTRING(path)->ptr) ||
+			Checkpoint::isCheckpointFile(RSTRING(path)->ptr)) {
+			continue;
+		}
+
+		::rb_ary_push(paths, path);
+	}
+
+	return paths;
+}
+
 void CapFile::closeCaptureFile() {
+    if (_reader) {
+        delete _reader;
+        _reader = NULL;
+    }
+    _memoryMapped = FALSE;
+    _isSet = FALSE;
+
+    if (_frameIndex) {
+        delete _frameIndex;
+        _frameIndex = NULL;
+    }
+    _saveFrameIndex = FALSE;
+
+    if (_randomWth) {
+        ::wtap_close(_randomWth);
+        _randomWth = NULL;
+    }
+    _seekBuffer.clear();
+
+    _position.cumBytes = 0;
+    _position.lastRecordOffset = -1;
+    _checkpointPath.clear();
+    _lastCheckpointFrame = 0;
+
     if (_cf.wth) {
 		::wtap_close(_cf.wth);
     }
@@ -533,15 +998,20 @@ void CapFile::closeCaptureFile() {
 		_cf.rfcode = NULL;
 	}
 
-    memset(&_cf, 0, sizeof(_cf));
-
-#ifdef USE_LOOKASIDE_LIST
-	_nodeLookaside.emptyPool();
+#ifdef HAVE_LIBPCAP
+	if (_captureFilter) {
+		delete _captureFilter;
+		_captureFilter = NULL;
+	}
 #endif
-    
+
+    freeColumns();
+    memset(&_cf, 0, sizeof(_cf));
 }
 	
-void CapFile::setDisplayFilter(VALUE filter) {
+void CapFile::setDisplayFilter(VALUE filter, gboolean filterFirst) {
+	_filterFirst = filterFirst;
+
 	if (NIL_P(filter)) {
 		//Clear the filter
 		_cf.rfcode = NULL;
@@ -558,6 +1028,273 @@ void CapFile::setDisplayFilter(VALUE filter) {
 	}
 }
 
+void CapFile::setCaptureFilter(VALUE filter) {
+#ifdef HAVE_LIBPCAP
+	ensureOpen();
+
+	if (NIL_P(filter)) {
+		//Clear the filter
+		delete _captureFilter;
+		_captureFilter = NULL;
+		return;
+	}
+
+	SafeStringValue(filter);
+	CaptureFilter* captureFilter = new CaptureFilter(RSTRING(filter)->ptr, static_cast<int>(_cf.snap));
+
+	//Compile for the file's encapsulation now, so a bad expression is reported here rather than
+	//silently matching nothing.  Per-packet encapsulations are compiled as they turn up
+	wtap* wth = _isSet ? static_cast<MergingRecordReader*>(_reader)->getFirstWth() : _cf.wth;
+	int encap = ::wtap_file_encap(wth);
+	if (encap != WTAP_ENCAP_PER_PACKET) {
+		std::string errMsg;
+		if (!captureFilter->compile(encap, errMsg)) {
+			delete captureFilter;
+			::rb_raise(g_capfile_error_class,
+				"%s", errMsg.c_str());
+		}
+	}
+
+	delete _captureFilter;
+	_captureFilter = captureFilter;
+#else
+	filter;
+	::rb_raise(g_capfile_error_class, 
+		"Capture filters aren't supported; rcapdissector was built without libpcap");
+#endif
+}
+
+void CapFile::setSaveFrameIndex(gboolean save) {
+	ensureOpen();
+	ensureSingleFile("Saving a frame index");
+
+	_saveFrameIndex = save;
+	if (!save) {
+		return;
+	}
+
+	if (_frameIndex) {
+		//Built for random access, or loaded from the sidecar, in which case this rewrites it as it was
+		if (_frameIndex->isComplete()) {
+			_frameIndex->save(_cf.filename);
+		}
+	} else if (_position.lastRecordOffset == -1) {
+		//Nothing has been read yet, so index the frames as the sequential pass reads them, which is
+		//cheaper than scanning the file separately
+		_frameIndex = new FrameIndex();
+		_reader = new IndexingRecordReader(_reader, *_frameIndex, _cf.filename);
+	} else {
+		ensureFrameIndex();
+	}
+}
+
+void CapFile::setInterestedFields(VALUE names) {
+	//Check every name before changing anything.  The elements need not be Strings, only convertible to
+	//them, so keep what each one named rather than going back to the array
+	std::vector<header_field_info*> fields;
+	if (!NIL_P(names)) {
+		Check_Type(names, T_ARRAY);
+
+		for (long idx = 0; idx < RARRAY(names)->len; idx++) {
+			VALUE name = RARRAY(names)->ptr[idx];
+			SafeStringValue(name);
+
+			header_field_info* hfinfo = ::proto_registrar_get_byname(RSTRING(name)->ptr);
+			if (!hfinfo) {
+				::rb_raise(::rb_eArgError, "'%s' is not a known field name", RSTRING(name)->ptr);
+			}
+			fields.push_back(hfinfo);
+		}
+	}
+
+	_interestedHfIds.clear();
+	_interestedHfMask.clear();
+
+	//nil, or an empty Array, means every field is of interest again
+	if (fields.empty()) {
+		return;
+	}
+
+	for (std::vector<header_field_info*>::const_iterator field = fields.begin();
+		field != fields.end();
+		++field) {
+		header_field_info* hfinfo = *field;
+
+		//Several fields can be registered under the same name, and any of them might turn up in the tree
+		while (hfinfo->same_name_prev) {
+			hfinfo = hfinfo->same_name_prev;
+		}
+		for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+			_interestedHfIds.push_back(hfinfo->id);
+		}
+	}
+
+	_interestedHfMask.resize(static_cast<size_t>(::proto_registrar_n()), false);
+	for (std::vector<int>::const_iterator iter = _interestedHfIds.begin();
+		iter != _interestedHfIds.end();
+		++iter) {
+		if (*iter >= 0 && static_cast<size_t>(*iter) < _interestedHfMask.size()) {
+			_interestedHfMask[*iter] = true;
+		}
+	}
+}
+
+void CapFile::setColumns(VALUE columns) {
+	ensureOpen();
+
+	std::vector<gint> formats;
+	std::vector<std::string> fields;
+
+	if (NIL_P(columns)) {
+		//Back to the defaults
+		for (size_t idx = 0; idx < NUM_DEFAULT_COLUMNS; idx++) {
+			formats.push_back(DEFAULT_COLUMNS[idx].format);
+			fields.push_back(std::string());
+		}
+	} else {
+		Check_Type(columns, T_ARRAY);
+
+		//Symbols name built-in columns; Strings name fields to show in custom columns
+		for (long idx = 0; idx < RARRAY(columns)->len; idx++) {
+			VALUE column = RARRAY(columns)->ptr[idx];
+
+			if (SYMBOL_P(column)) {
+				const char* name = ::rb_id2name(SYM2ID(column));
+				gint format = columnFormatFromName(name);
+				if (format < 0) {
+					::rb_raise(::rb_eArgError, "'%s' is not a known column", name);
+				}
+
+				formats.push_back(format);
+				fields.push_back(std::string());
+			} else {
+				SafeStringValue(column);
+				if (!::proto_registrar_get_byname(RSTRING(column)->ptr)) {
+					::rb_raise(::rb_eArgError, "'%s' is not a known field name", RSTRING(column)->ptr);
+				}
+
+				formats.push_back(COL_CUSTOM);
+				fields.push_back(RSTRING(column)->ptr);
+			}
+		}
+	}
+
+	freeColumns();
+	_columnFormats.swap(formats);
+	_columnFields.swap(fields);
+	setupColumns();
+}
+
+gint CapFile::columnFormatFromName(const char* name) {
+	for (size_t idx = 0; idx < NUM_DEFAULT_COLUMNS; idx++) {
+		if (::strcmp(DEFAULT_COLUMNS[idx].name, name) == 0) {
+			return DEFAULT_COLUMNS[idx].format;
+		}
+	}
+
+	return -1;
+}
+
+void CapFile::setCheckpointFile(VALUE path, long interval) {
+	ensureOpen();
+	ensureSingleFile("Checkpointing");
+
+	SafeStringValue(path);
+	const char* checkpointPath = RSTRING(path)->ptr;
+
+	//Resuming means skipping the frames already processed, which can't be done part-way through
+	if (_cf.count != 0) {
+		::rb_raise(g_capfile_error_class, 
+			"set_checkpoint_file must be called before any packets are read");
+	}
+
+	Checkpoint checkpoint;
+	Checkpoint::LoadResult result = checkpoint.load(checkpointPath);
+	if (result == Checkpoint::INVALID) {
+		::rb_raise(g_capfile_error_class,
+			"The file \"%s\" is not a valid rcapdissector checkpoint",
+			checkpointPath);
+	} else if (result == Checkpoint::LOADED) {
+		if (!checkpoint.isFrom(_cf.filename)) {
+			::rb_raise(g_capfile_error_class,
+				"The checkpoint \"%s\" was taken from \"%s\", not \"%s\"",
+				checkpointPath,
+				checkpoint.captureFile.c_str(),
+				_cf.filename);
+		}
+
+		resumeFromCheckpoint(checkpoint);
+	}
+
+	_checkpointPath = checkpointPath;
+	_checkpointInterval = interval;
+	_lastCheckpointFrame = static_cast<guint32>(_cf.count);
+}
+
+void CapFile::resumeFromCheckpoint(const Checkpoint& checkpoint) {
+	if (checkpoint.frameCount == 0) {
+		return;
+	}
+
+	int err = 0;
+	gchar* errInfo = NULL;
+	RawRecord record;
+	record.offset = -1;
+
+	//Jump straight to the last frame processed if the reader can; otherwise read past every
+	//frame up to it, which costs the I/O but not the dissection
+	if (_reader->seek(checkpoint.position.lastRecordOffset)) {
+		if (!_reader->readNext(record, &err, &errInfo)) {
+			record.offset = -1;
+		}
+	} else {
+		for (guint32 idx = 0; idx < checkpoint.frameCount; idx++) {
+			if (!_reader->readNext(record, &err, &errInfo)) {
+				record.offset = -1;
+				break;
+			}
+		}
+	}
+
+	if (errInfo) {
+		::g_free(errInfo);
+	}
+
+	if (record.offset != checkpoint.position.lastRecordOffset) {
+		::rb_raise(g_capfile_error_class,
+			"The capture file \"%s\" doesn't match its checkpoint; it may have been replaced or truncated",
+			_cf.filename);
+	}
+
+	_cf.count = static_cast<int>(checkpoint.frameCount);
+	_position = checkpoint.position;
+}
+
+void CapFile::writeCheckpoint(bool force) {
+	if (_checkpointPath.empty()) {
+		return;
+	}
+
+	guint32 frameCount = static_cast<guint32>(_cf.count);
+	if (!force && frameCount - _lastCheckpointFrame < static_cast<guint32>(_checkpointInterval)) {
+		return;
+	}
+
+	Checkpoint checkpoint;
+	//Saved as a canonical path, so a later run can resume however it names the file
+	checkpoint.captureFile = Checkpoint::getCanonicalPath(_cf.filename);
+	checkpoint.frameCount = frameCount;
+	checkpoint.position = _position;
+
+	if (!checkpoint.save(_checkpointPath.c_str())) {
+		::rb_raise(g_capfile_error_class,
+			"Unable to write checkpoint file \"%s\"",
+			_checkpointPath.c_str());
+	}
+
+	_lastCheckpointFrame = frameCount;
+}
+
 void CapFile::eachPacket() {
 	rb_need_block();
 
@@ -565,13 +1302,414 @@ void CapFile::eachPacket() {
 		rb_raise(rb_eArgError, "each_packet must be invoked with a block");
 	}
 
+	ensureOpen();
+
 
 	//TODO: Move into this module
 	VALUE packet = Qnil;
-	while (Packet::getNextPacket(_self, _cf, packet)) {
+	while (Packet::getNextPacket(_self, _cf, *_reader, _position, packet)) {
 		rb_yield(packet);
 		/** Free up the resources for this packet so they can be used by the next one */
 		Packet::freePacket(packet);
+
+		//Every frame up to this one has now been dealt with
+		writeCheckpoint(false);
+	}
+
+	writeCheckpoint(true);
+}
+
+void CapFile::eachPacketBatch(long batchSize) {
+	rb_need_block();
+
+	if (!rb_block_given_p()) {
+		rb_raise(rb_eArgError, "each_packet_batch must be invoked with a block");
+	}
+
+	ensureOpen();
+
+	VALUE packet = Qnil;
+	gboolean morePackets = TRUE;
+	while (morePackets) {
+		//Use a new array for each batch, in case the block holds on to the one it was given
+		VALUE batch = ::rb_ary_new2(batchSize);
+
+		while (RARRAY(batch)->len < batchSize) {
+			//Every packet in the batch stays alive until the batch is yielded, so their frame data
+			//has to as well
+			morePackets = Packet::getNextPacket(_self, _cf, *_reader, _position, packet, TRUE);
+			if (!morePackets) {
+				break;
+			}
+
+			//The column data lives in _cf and is overwritten by the next packet, so each packet
+			//in the batch needs its own copy
+			Packet::snapshotPacketColumns(packet);
+			::rb_ary_push(batch, packet);
+		}
+
+		if (RARRAY(batch)->len == 0) {
+			break;
+		}
+
+		rb_yield(batch);
+
+		/** Free up the resources for the whole batch so they can be used by the next one */
+		for (long idx = 0; idx < RARRAY(batch)->len; idx++) {
+			Packet::freePacket(RARRAY(batch)->ptr[idx]);
+		}
+
+		writeCheckpoint(false);
+	}
+
+	writeCheckpoint(true);
+}
+
+void CapFile::eachPacketFollowing(VALUE idleTimeout) {
+	rb_need_block();
+
+	if (!rb_block_given_p()) {
+		rb_raise(rb_eArgError, "each_packet must be invoked with a block");
+	}
+
+	ensureOpen();
+	ensureSingleFile("Following");
+
+	//With no :idle_timeout, keep following until the block breaks out
+	long idleTimeoutMsecs = -1;
+	if (!NIL_P(idleTimeout)) {
+		double idleTimeoutSecs = NUM2DBL(idleTimeout);
+		if (idleTimeoutSecs < 0) {
+			::rb_raise(::rb_eArgError, "The :idle_timeout cannot be negative");
+		}
+		idleTimeoutMsecs = static_cast<long>(idleTimeoutSecs * 1000);
+	}
+
+	FileWatcher watcher(_cf.filename);
+	long idleMsecs = 0;
+
+	VALUE packet = Qnil;
+	for (;;) {
+		int countBefore = _cf.count;
+		while (Packet::getNextPacket(_self, _cf, *_reader, _position, packet, FALSE, TRUE)) {
+			rb_yield(packet);
+			/** Free up the resources for this packet so they can be used by the next one */
+			Packet::freePacket(packet);
+
+			writeCheckpoint(false);
+		}
+
+		//Caught up with the writer
+		if (_cf.count != countBefore) {
+			idleMsecs = 0;
+			writeCheckpoint(true);
+		}
+
+		if (idleTimeoutMsecs >= 0 && idleMsecs >= idleTimeoutMsecs) {
+			break;
+		}
+
+		long waitMsecs = FOLLOW_POLL_INTERVAL_MSECS;
+		if (idleTimeoutMsecs >= 0 && idleTimeoutMsecs - idleMsecs < waitMsecs) {
+			waitMsecs = idleTimeoutMsecs - idleMsecs;
+		}
+
+		GTimeVal waitStart, waitEnd;
+		::g_get_current_time(&waitStart);
+		watcher.wait(waitMsecs);
+		::g_get_current_time(&waitEnd);
+		long waitedMsecs = (waitEnd.tv_sec - waitStart.tv_sec) * 1000 + (waitEnd.tv_usec - waitStart.tv_usec) / 1000;
+		if (waitedMsecs > 0) {
+			//Ignore the clock going backwards
+			idleMsecs += waitedMsecs;
+		}
+
+		//Pick up whatever has been written since, including the rest of a record that was cut short
+		if (!_reader->refresh()) {
+			::rb_raise(g_capfile_error_class,
+				"Unable to continue reading \"%s\"; either it was truncated, or it ends part-way through a record that can't be re-read. "
+				"Partial records can only be resumed for pcap files read through a memory mapping",
+				_cf.filename);
+		}
+	}
+}
+
+void CapFile::eachPacketInRange(VALUE range) {
+	rb_need_block();
+
+	if (!rb_block_given_p()) {
+		rb_raise(rb_eArgError, "each_packet must be invoked with a block");
+	}
+
+	ensureOpen();
+	ensureSingleFile("Reading a :range of frames");
+
+	if (!::rb_obj_is_kind_of(range, ::rb_cRange)) {
+		::rb_raise(::rb_eTypeError, "The :range option must be a Range of frame numbers");
+	}
+
+	long first = NUM2LONG(::rb_funcall(range, ::rb_intern("first"), 0));
+	long last = NUM2LONG(::rb_funcall(range, ::rb_intern("last"), 0));
+	if (RTEST(::rb_funcall(range, ::rb_intern("exclude_end?"), 0))) {
+		last--;
+	}
+
+	if (first < 1) {
+		first = 1;
+	}
+
+	ensureFrameIndex();
+
+	for (long frameNumber = first; frameNumber <= last; frameNumber++) {
+		if (frameNumber > static_cast<long>(_frameIndex->getFrameCount())) {
+			//Past the end of the capture
+			break;
+		}
+
+		VALUE packet = packetAt(frameNumber);
+		if (NIL_P(packet)) {
+			//Didn't pass the capture or display filter
+			continue;
+		}
+
+		rb_yield(packet);
+		/** Free up the resources for this packet so they can be used by the next one */
+		Packet::freePacket(packet);
+	}
+}
+
+void CapFile::eachPacketInTimeRange(VALUE from, VALUE to, VALUE warmUp) {
+	rb_need_block();
+
+	if (!rb_block_given_p()) {
+		rb_raise(rb_eArgError, "each_packet must be invoked with a block");
+	}
+
+	ensureOpen();
+	ensureSingleFile("Seeking to a :from time");
+
+	//:from and :to can be Time objects or seconds since the epoch
+	gint64 fromUsecs = G_MININT64;
+	if (!NIL_P(from)) {
+		struct timeval tv = ::rb_time_timeval(from);
+		fromUsecs = static_cast<gint64>(tv.tv_sec) * G_USEC_PER_SEC + tv.tv_usec;
+	}
+
+	gint64 toUsecs = G_MAXINT64;
+	if (!NIL_P(to)) {
+		struct timeval tv = ::rb_time_timeval(to);
+		toUsecs = static_cast<gint64>(tv.tv_sec) * G_USEC_PER_SEC + tv.tv_usec;
+	}
+
+	gint64 warmUpUsecs = 0;
+	if (!NIL_P(warmUp)) {
+		double warmUpSecs = NUM2DBL(warmUp);
+		if (warmUpSecs < 0) {
+			::rb_raise(::rb_eArgError, "The :warm_up period cannot be negative");
+		}
+		warmUpUsecs = static_cast<gint64>(warmUpSecs * G_USEC_PER_SEC);
+	}
+
+	ensureFrameIndex();
+
+	guint32 frameCount = _frameIndex->getFrameCount();
+	guint32 firstFrame = 1;
+	guint32 warmUpFrame = 1;
+	if (fromUsecs != G_MININT64) {
+		firstFrame = _frameIndex->findFirstFrameAtOrAfter(fromUsecs / G_USEC_PER_SEC, 
+			static_cast<gint32>(fromUsecs % G_USEC_PER_SEC) * 1000);
+
+		gint64 warmUpUsecsFrom = fromUsecs - warmUpUsecs;
+		warmUpFrame = _frameIndex->findFirstFrameAtOrAfter(warmUpUsecsFrom / G_USEC_PER_SEC, 
+			static_cast<gint32>(warmUpUsecsFrom % G_USEC_PER_SEC) * 1000);
+	}
+
+	//Feed the frames in the lead-in to the dissectors so reassembly and conversation state
+	//is primed by the time the window starts, but don't build anything for them
+	for (guint32 frameNumber = warmUpFrame; frameNumber < firstFrame; frameNumber++) {
+		struct wtap_pkthdr phdr;
+		union wtap_pseudo_header pseudoHeader;
+		RawRecord record;
+
+		seekReadFrame(frameNumber, phdr, pseudoHeader, record);
+
+		//A sequential pass would never have dissected a frame the capture filter rejects
+		if (passesCaptureFilter(record)) {
+			Packet::primeDissectors(*_dissectPool, _cf, record, frameNumber);
+		}
+	}
+
+	for (guint32 frameNumber = firstFrame; frameNumber <= frameCount; frameNumber++) {
+		const FrameIndexEntry& entry = _frameIndex->getEntry(frameNumber);
+		if (entry.tsSecs * G_USEC_PER_SEC + entry.tsNsecs / 1000 > toUsecs) {
+			break;
+		}
+
+		VALUE packet = readIndexedFrame(frameNumber);
+		if (NIL_P(packet)) {
+			//Didn't pass the capture or display filter
+			continue;
+		}
+
+		rb_yield(packet);
+		/** Free up the resources for this packet so they can be used by the next one */
+		Packet::freePacket(packet);
+	}
+}
+
+VALUE CapFile::packetAt(long frameNumber) {
+	ensureOpen();
+	ensureSingleFile("Random access to frames");
+
+	if (frameNumber < 1) {
+		::rb_raise(::rb_eArgError, "Frame numbers start at 1");
+	}
+
+	ensureFrameIndex();
+
+	if (frameNumber > static_cast<long>(_frameIndex->getFrameCount())) {
+		//There's no such frame
+		return Qnil;
+	}
+
+	return readIndexedFrame(static_cast<guint32>(frameNumber));
+}
+
+VALUE CapFile::readIndexedFrame(guint32 frameNumber) {
+	struct wtap_pkthdr phdr;
+	union wtap_pseudo_header pseudoHeader;
+	RawRecord record;
+
+	seekReadFrame(frameNumber, phdr, pseudoHeader, record);
+
+	return Packet::dissectRecord(_self, _cf, record, frameNumber);
+}
+
+void CapFile::seekReadFrame(guint32 frameNumber, struct wtap_pkthdr& phdr, union wtap_pseudo_header& pseudoHeader, RawRecord& record) {
+	openRandomAccess();
+
+	const FrameIndexEntry& entry = _frameIndex->getEntry(frameNumber);
+
+	FrameIndex::entryToPhdr(entry, phdr);
+	::memset(&pseudoHeader, 0, sizeof(pseudoHeader));
+
+	if (_seekBuffer.size() < entry.caplen || _seekBuffer.empty()) {
+		_seekBuffer.resize(entry.caplen > 0 ? entry.caplen : 1);
+	}
+
+	int err = 0;
+	gchar* errInfo = NULL;
+	if (!::wtap_seek_read(_randomWth, entry.offset, &pseudoHeader, &_seekBuffer[0], entry.caplen, &err, &errInfo)) {
+		std::string msg = "Error reading frame from \"";
+		msg += _cf.filename;
+		msg += "\": ";
+		msg += ::wtap_strerror(err);
+		if (errInfo) {
+			msg += " (";
+			msg += errInfo;
+			msg += ")";
+			::g_free(errInfo);
+		}
+
+		::rb_raise(g_capfile_error_class, "%s", msg.c_str());
+	}
+
+	record.phdr = &phdr;
+	record.pseudoHeader = &pseudoHeader;
+	record.data = &_seekBuffer[0];
+	record.offset = entry.offset;
+}
+
+void CapFile::ensureFrameIndex() {
+	//An index is out of date if a followed file has grown past it
+	if (_frameIndex &&
+		_frameIndex->isComplete() &&
+		_frameIndex->getFrameCount() >= static_cast<guint32>(_cf.count)) {
+		return;
+	}
+
+	//Walk the record headers of the whole file with a reader of our own, leaving the sequential
+	//reader where it is.  Nothing is dissected, so this costs little more than the I/O
+	int err = 0;
+	gchar* errInfo = NULL;
+	char errMsg[2048+1];
+
+	wtap* wth = ::wtap_open_offline(_cf.filename, &err, &errInfo, FALSE);
+	if (!wth) {
+		g_snprintf(errMsg, 
+			sizeof errMsg,
+			buildCfOpenErrorMessage(err, errInfo, FALSE, _cf.cd_t), _cf.filename);
+		rb_raise(g_wtapcapfile_error_class, errMsg, err);
+	}
+
+	RecordReader* reader = MappedPcapRecordReader::open(_cf.filename, wth);
+	if (!reader) {
+		reader = new WtapRecordReader(wth);
+	}
+
+	FrameIndex index;
+	RawRecord record;
+	while (reader->readNext(record, &err, &errInfo)) {
+		index.append(record);
+	}
+
+	delete reader;
+	::wtap_close(wth);
+
+	if (err != 0) {
+		std::string msg = "Error indexing \"";
+		msg += _cf.filename;
+		msg += "\": ";
+		msg += ::wtap_strerror(err);
+		if (errInfo) {
+			msg += " (";
+			msg += errInfo;
+			msg += ")";
+			::g_free(errInfo);
+		}
+
+		::rb_raise(g_capfile_error_class, "%s", msg.c_str());
+	}
+
+	index.setComplete();
+	if (_saveFrameIndex) {
+		index.save(_cf.filename);
+	}
+
+	//Swap rather than replace, since an IndexingRecordReader may hold a reference to _frameIndex
+	if (!_frameIndex) {
+		_frameIndex = new FrameIndex();
+	}
+	_frameIndex->swap(index);
+}
+
+void CapFile::openRandomAccess() {
+	if (_randomWth) {
+		return;
+	}
+
+	int err = 0;
+	gchar* errInfo = NULL;
+	char errMsg[2048+1];
+
+	_randomWth = ::wtap_open_offline(_cf.filename, &err, &errInfo, TRUE);
+	if (!_randomWth) {
+		g_snprintf(errMsg, 
+			sizeof errMsg,
+			buildCfOpenErrorMessage(err, errInfo, FALSE, _cf.cd_t), _cf.filename);
+		rb_raise(g_wtapcapfile_error_class, errMsg, err);
+	}
+}
+
+void CapFile::ensureSingleFile(const char* operation) {
+	if (_isSet) {
+		::rb_raise(g_capfile_error_class, "%s is not supported for capture file sets", operation);
+	}
+}
+
+void CapFile::ensureOpen() {
+	if (!_reader) {
+		::rb_raise(g_capfile_error_class, "The capture file has been closed");
 	}
 }
 
@@ -663,12 +1801,21 @@ void CapFile::setupColumns() {
 */
   //This determines what sort of timestamp the COL_CLS_TIME is
   timestamp_set_type(TS_ABSOLUTE_WITH_DATE);
-  col_setup(&_cf.cinfo, NUM_COLUMNS);
+
+  //With no columns, packets are dissected without column info, and nothing is ever formatted
+  if (_columnFormats.empty()) {
+    return;
+  }
+
+  col_setup(&_cf.cinfo, static_cast<gint>(_columnFormats.size()));
   int i = 0;
   for (i = 0; i < _cf.cinfo.num_cols; i++) {
-    _cf.cinfo.col_fmt[i] = COLUMNS[i];
-    _cf.cinfo.col_title[i] = g_strdup(col_format_desc(COLUMNS[i]));
-    _cf.cinfo.col_custom_field[i] = NULL;
+    _cf.cinfo.col_fmt[i] = _columnFormats[i];
+    _cf.cinfo.col_title[i] = g_strdup(col_format_desc(_columnFormats[i]));
+    if (_cf.cinfo.col_fmt[i] == COL_CUSTOM)
+      _cf.cinfo.col_custom_field[i] = g_strdup(_columnFields[i].c_str());
+    else
+      _cf.cinfo.col_custom_field[i] = NULL;
     _cf.cinfo.fmt_matx[i] = (gboolean *) g_malloc0(sizeof(gboolean) *
       NUM_COL_FMTS);
     get_column_format_matches(_cf.cinfo.fmt_matx[i], _cf.cinfo.col_fmt[i]);
@@ -697,3 +1844,33 @@ void CapFile::setupColumns() {
 
 }
 
+void CapFile::freeColumns() {
+  if (_cf.cinfo.num_cols == 0) {
+    return;
+  }
+
+  for (int i = 0; i < _cf.cinfo.num_cols; i++) {
+    g_free(_cf.cinfo.col_title[i]);
+    g_free(_cf.cinfo.col_custom_field[i]);
+    g_free(_cf.cinfo.fmt_matx[i]);
+    g_free(_cf.cinfo.col_buf[i]);
+    g_free((gpointer)_cf.cinfo.col_expr.col_expr[i]);
+    g_free(_cf.cinfo.col_expr.col_expr_val[i]);
+  }
+
+  //...and the arrays col_setup allocated
+  g_free(_cf.cinfo.col_fmt);
+  g_free(_cf.cinfo.fmt_matx);
+  g_free(_cf.cinfo.col_first);
+  g_free(_cf.cinfo.col_last);
+  g_free(_cf.cinfo.col_title);
+  g_free(_cf.cinfo.col_custom_field);
+  g_free((gpointer)_cf.cinfo.col_data);
+  g_free(_cf.cinfo.col_buf);
+  g_free(_cf.cinfo.col_fence);
+  g_free((gpointer)_cf.cinfo.col_expr.col_expr);
+  g_free(_cf.cinfo.col_expr.col_expr_val);
+
+  memset(&_cf.cinfo, 0, sizeof(_cf.cinfo));
+}
+
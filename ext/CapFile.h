@@ -3,22 +3,57 @@
 #include "RubyAndShit.h"
 
 #include "rcapdissector.h"
+#include "RecordReader.h"
+#include "FrameIndex.h"
+#include "Checkpoint.h"
+#include "CaptureFilter.h"
+#include "EpanDissectPool.h"
 
-#ifdef USE_LOOKASIDE_LIST
-#include "RubyAllocator.h"
-#include "ProtocolTreeNodeLookasideList.h"
-#endif
+#include <vector>
+
+/** The number of packets dissected and yielded together by each_packet_batch when
+ *  the caller doesn't specify a batch size */
+#define DEFAULT_PACKET_BATCH_SIZE               64
 
 class CapFile
 {
 public:
 	static VALUE createClass();
 
+	/** Creates the CapFileSet class, a CapFile that reads several capture files merged into one.  Must be
+	called after createClass */
+	static VALUE createSetClass();
+
 	static void initPacketCapture();
 	static void deinitPacketCapture();
 
-#ifdef USE_LOOKASIDE_LIST
-	ProtocolTreeNodeLookasideList& getNodeLookasideList() { return _nodeLookaside; }
+	/** The dissection contexts recycled between this capture file's packets */
+	EpanDissectPool& getDissectPool() { return *_dissectPool; }
+
+	/** True if any columns are set up; if not, packets are dissected without column info at all.  That's the
+	only way jobs that just walk the tree avoid the cost of the dissectors formatting COL_INFO and the like */
+	gboolean hasColumns() const { return !_columnFormats.empty(); }
+
+	/** Maps the name of a built-in column, which is the name of the Packet method that reads it, to its
+	column format.  Returns -1 if there's no such column */
+	static gint columnFormatFromName(const char* name);
+
+	/** The header field ids of the fields named by interested_fields=, including every field registered under
+	those names, or empty if all fields are of interest */
+	const std::vector<int>& getInterestedHfIds() const { return _interestedHfIds; }
+
+	/** Flags, indexed by header field id, marking the interested fields; empty if all fields are of interest */
+	const std::vector<bool>& getInterestedHfMask() const { return _interestedHfMask; }
+
+	/** True if packets are run through the display filter with a minimal tree first, and only dissected in
+	full if they pass */
+	gboolean isFilterFirst() const { return _filterFirst; }
+
+	/** Checks a raw record against the capture filter, if any, before it's dissected */
+#ifdef HAVE_LIBPCAP
+	gboolean passesCaptureFilter(const RawRecord& record) { return !_captureFilter || _captureFilter->matches(record); }
+#else
+	gboolean passesCaptureFilter(const RawRecord&) { return TRUE; }
 #endif
 
 private:
@@ -35,15 +70,28 @@ private:
 	static void free(void* p);
 	static VALUE alloc(VALUE klass);
 	static VALUE initialize(VALUE self, VALUE capfile);
+	static VALUE initialize_set(VALUE self, VALUE capfiles);
 	static VALUE init_copy(VALUE copy, VALUE orig);
 
 	static VALUE set_preference(VALUE klass, VALUE name, VALUE value);
 	static VALUE set_wlan_decryption_key(VALUE klass, VALUE key);
 	static VALUE set_wlan_decryption_keys(VALUE klass, VALUE keys);
+	static VALUE set_read_ahead_depth(VALUE klass, VALUE depth);
 
-	static VALUE set_display_filter(VALUE self, VALUE filter); 
+	static VALUE set_display_filter(int argc, VALUE* argv, VALUE self); 
+	static VALUE set_capture_filter(VALUE self, VALUE filter);
+	static VALUE set_interested_fields(VALUE self, VALUE names);
+	static VALUE set_columns(VALUE self, VALUE columns);
+	static VALUE set_save_frame_index(VALUE self, VALUE save);
+	static VALUE set_checkpoint_file(int argc, VALUE* argv, VALUE self);
 
-	static VALUE each_packet(VALUE self);
+	static VALUE each_packet(int argc, VALUE* argv, VALUE self);
+	static VALUE each_packet_batch(int argc, VALUE* argv, VALUE self);
+
+	static VALUE packet_at(VALUE self, VALUE frameNumber);
+
+	static VALUE is_memory_mapped(VALUE self);
+	static VALUE dissection_context_stats(VALUE self);
 
     static VALUE close_capture_file(VALUE self);
 
@@ -51,9 +99,51 @@ private:
 
 	/*@ Instance methods that actually perform the CapFile-specific work */
 	void openCaptureFile(VALUE capFileName);
+	void openCaptureFileSet(VALUE capFileNames, VALUE paths);
 	void closeCaptureFile();
-	void setDisplayFilter(VALUE filter);
+	void setDisplayFilter(VALUE filter, gboolean filterFirst);
+	void setCaptureFilter(VALUE filter);
+	void setInterestedFields(VALUE names);
+	void setColumns(VALUE columns);
+	void setSaveFrameIndex(gboolean save);
+	void setCheckpointFile(VALUE path, long interval);
 	void eachPacket();
+	void eachPacketBatch(long batchSize);
+	void eachPacketInRange(VALUE range);
+	void eachPacketInTimeRange(VALUE from, VALUE to, VALUE warmUp);
+	void eachPacketFollowing(VALUE idleTimeout);
+	VALUE packetAt(long frameNumber);
+
+	/** Re-reads and dissects an indexed frame via wtap_seek_read */
+	VALUE readIndexedFrame(guint32 frameNumber);
+
+	/** Re-reads an indexed frame via wtap_seek_read into _seekBuffer, filling in 'record' and the
+	header structures it points to */
+	void seekReadFrame(guint32 frameNumber, struct wtap_pkthdr& phdr, union wtap_pseudo_header& pseudoHeader, RawRecord& record);
+
+	/** Makes sure _frameIndex exists and covers the whole file, scanning the record headers if need be.  Only
+	random access needs the index, so it's built the first time packet_at, :range or :from is used */
+	void ensureFrameIndex();
+
+	/** Moves the sequential reader past the frames covered by a checkpoint, and picks up the frame
+	numbering and running totals from there */
+	void resumeFromCheckpoint(const Checkpoint& checkpoint);
+
+	/** Writes a checkpoint if one is due, or unconditionally if 'force' is true */
+	void writeCheckpoint(bool force);
+
+	/** Opens the random-access wiretap handle used for indexed reads, if it isn't already */
+	void openRandomAccess();
+
+	/** Raises a CapFileError if the capture file has been closed */
+	void ensureOpen();
+
+	/** Raises a CapFileError if this object is a capture file set, naming the operation sets don't support */
+	void ensureSingleFile(const char* operation);
+
+	/** Expands the argument to CapFileSet.new, which is a directory, a glob pattern, or an Array of paths,
+	into an Array of paths */
+	static VALUE expandCaptureFileSet(VALUE capFileNames);
 
 	static void setPreference(const char* name, const char* value);
 	static void setWlanDecryptionKey(VALUE key);
@@ -61,13 +151,65 @@ private:
 
         void setupColumns();
 
-        static gint* COLUMNS;
-        static gint NUM_COLUMNS;
+	/** Frees the column buffers allocated by setupColumns */
+	void freeColumns();
+
+	/** The number of records the background thread reads ahead for files not read from a memory
+	mapping; 0 to read in the foreground */
+	static long READ_AHEAD_DEPTH;
 
 	VALUE _self;
 	capture_file _cf;
-#ifdef USE_LOOKASIDE_LIST
-	RubyAllocator _allocator;
-	ProtocolTreeNodeLookasideList _nodeLookaside;
+
+	/** The source of the raw records this object dissects */
+	RecordReader* _reader;
+
+	/** True if _reader reads straight from a memory mapping of the capture file */
+	gboolean _memoryMapped;
+
+	/** Where packets get their epan_dissect_t's; packets take their own reference to it, so it can outlive
+	this object */
+	EpanDissectPool* _dissectPool;
+
+	/** The format of each column to set up, and for COL_CUSTOM columns, the field each displays; the field
+	name is empty for the built-in columns */
+	std::vector<gint> _columnFormats;
+	std::vector<std::string> _columnFields;
+
+	/** The fields Ruby code will look at; see getInterestedHfIds and getInterestedHfMask */
+	std::vector<int> _interestedHfIds;
+	std::vector<bool> _interestedHfMask;
+
+	/** True if the display filter is applied in a cheap first pass; see isFilterFirst */
+	gboolean _filterFirst;
+
+	/** True if this is a CapFileSet, reading several files merged together */
+	gboolean _isSet;
+
+	/** The index of the frames in the file; NULL until random access needs it, unless the sidecar from an
+	earlier run was loaded at open.  If save_frame_index= was set before reading started, it's built as the
+	file is read sequentially instead */
+	FrameIndex* _frameIndex;
+
+	/** True if the frame index is written to the sidecar next to the capture once it's complete */
+	gboolean _saveFrameIndex;
+
+	/** A second wiretap handle for wtap_seek_read, so random access never disturbs the sequential reader */
+	wtap* _randomWth;
+
+	/** Buffer into which frames are read by wtap_seek_read */
+	std::vector<guint8> _seekBuffer;
+
+	/** How far the sequential reader has got */
+	ReadPosition _position;
+
+	/** Where checkpoints are written, or empty if they aren't; how many frames apart; and the frame
+	count as of the last one */
+	std::string _checkpointPath;
+	long _checkpointInterval;
+	guint32 _lastCheckpointFrame;
+#ifdef HAVE_LIBPCAP
+	/** BPF filter applied to raw records ahead of dissection, or NULL */
+	CaptureFilter* _captureFilter;
 #endif
 };
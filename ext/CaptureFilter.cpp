@@ -0,0 +1,92 @@
+#include "CaptureFilter.h"
+
+#ifdef HAVE_LIBPCAP
+
+CaptureFilter::CaptureFilter(const char* expression, int snapLength) :
+	_expression(expression)
+{
+	_snapLength = snapLength;
+}
+
+CaptureFilter::~CaptureFilter(void)
+{
+	for (ProgramMap::iterator iter = _programs.begin();
+		iter != _programs.end();
+		++iter) {
+		if (iter->second) {
+			::pcap_freecode(iter->second);
+			delete iter->second;
+		}
+	}
+	_programs.clear();
+}
+
+bool CaptureFilter::compile(int encap, std::string& errMsg) {
+	ProgramMap::const_iterator existing = _programs.find(encap);
+	if (existing != _programs.end()) {
+		if (!existing->second) {
+			errMsg = "The capture filter can't be applied to this capture file's encapsulation";
+			return false;
+		}
+		return true;
+	}
+
+	//Remember failures too, so a bad encapsulation isn't retried on every record
+	_programs[encap] = NULL;
+
+	int linkType = ::wtap_wtap_encap_to_pcap_encap(encap);
+	if (linkType < 0) {
+		const char* encapName = ::wtap_encap_string(encap);
+		errMsg = "Capture filters can't be applied to ";
+		errMsg += encapName ? encapName : "unknown";
+		errMsg += " frames";
+		return false;
+	}
+
+	//A dead handle is enough to compile against, and unlike pcap_compile_nopcap it can report why
+	//compilation failed
+	pcap_t* pcap = ::pcap_open_dead(linkType, _snapLength);
+	if (!pcap) {
+		errMsg = "Unable to initialize libpcap to compile the capture filter";
+		return false;
+	}
+
+	struct bpf_program* program = new struct bpf_program;
+	if (::pcap_compile(pcap, program, const_cast<char*>(_expression.c_str()), 1, 0) < 0) {
+		errMsg = "Error compiling capture filter: ";
+		errMsg += ::pcap_geterr(pcap);
+
+		delete program;
+		::pcap_close(pcap);
+		return false;
+	}
+
+	::pcap_close(pcap);
+	_programs[encap] = program;
+
+	return true;
+}
+
+bool CaptureFilter::matches(const RawRecord& record) {
+	int encap = record.phdr->pkt_encap;
+
+	ProgramMap::const_iterator iter = _programs.find(encap);
+	if (iter == _programs.end()) {
+		std::string errMsg;
+		if (!compile(encap, errMsg)) {
+			return false;
+		}
+		iter = _programs.find(encap);
+	}
+
+	if (!iter->second) {
+		return false;
+	}
+
+	return ::bpf_filter(iter->second->bf_insns, 
+		const_cast<guchar*>(record.data),
+		record.phdr->len,
+		record.phdr->caplen) != 0;
+}
+
+#endif /* HAVE_LIBPCAP */
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "RubyAndShit.h"
+#include "RecordReader.h"
+
+#ifdef HAVE_LIBPCAP
+
+#include <map>
+#include <string>
+
+/** A BPF capture filter, run over the raw bytes of each record before it's handed to the dissectors,
+ *  so records the caller has no interest in never pay for a dissection.
+ *
+ *  The expression is compiled once for each link-layer type it's applied to, since a file with
+ *  per-packet encapsulation, or a set of files, can mix them.  The filter sees the record data as
+ *  wiretap presents it, which for most encapsulations is exactly what libpcap would have seen */
+class CaptureFilter
+{
+public:
+	CaptureFilter(const char* expression, int snapLength);
+	virtual ~CaptureFilter(void);
+
+	/** Compiles the filter for a wiretap encapsulation, if it hasn't been already.  Returns false and fills
+	in 'errMsg' if the encapsulation has no libpcap equivalent or the expression doesn't compile for it */
+	bool compile(int encap, std::string& errMsg);
+
+	/** Runs the filter over a raw record.  Records with an encapsulation the filter can't be compiled for
+	never match */
+	bool matches(const RawRecord& record);
+
+	const std::string& getExpression() const { return _expression; }
+
+private:
+	//No copy ctor, and no assignment
+	CaptureFilter(const CaptureFilter&);
+	CaptureFilter& operator=(const CaptureFilter&);
+
+	/** The compiled program for one encapsulation, or NULL if it couldn't be compiled */
+	typedef std::map<int, struct bpf_program*> ProgramMap;
+
+	std::string _expression;
+	int _snapLength;
+	ProgramMap _programs;
+};
+
+#endif /* HAVE_LIBPCAP */
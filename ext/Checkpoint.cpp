@@ -0,0 +1,138 @@
+#include "Checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+
+/** The first line of every checkpoint file */
+#define CHECKPOINT_HEADER                       "rcapdissector checkpoint 1"
+
+Checkpoint::Checkpoint(void)
+{
+	frameCount = 0;
+	position.cumBytes = 0;
+	position.lastRecordOffset = -1;
+}
+
+Checkpoint::LoadResult Checkpoint::load(const char* path) {
+	std::ifstream file(path);
+	if (!file) {
+		return NOT_FOUND;
+	}
+
+	std::string line;
+	if (!std::getline(file, line) || line != CHECKPOINT_HEADER) {
+		return INVALID;
+	}
+
+	bool gotFrameCount = false, gotOffset = false, gotCumBytes = false;
+
+	while (std::getline(file, line)) {
+		std::string::size_type space = line.find(' ');
+		if (space == std::string::npos) {
+			continue;
+		}
+
+		std::string key = line.substr(0, space);
+		std::string value = line.substr(space + 1);
+		std::istringstream valueStream(value);
+
+		if (key == "capture_file") {
+			captureFile = value;
+		} else if (key == "frame_count") {
+			gotFrameCount = !!(valueStream >> frameCount);
+		} else if (key == "last_record_offset") {
+			long long offset = 0;
+			gotOffset = !!(valueStream >> offset);
+			position.lastRecordOffset = offset;
+		} else if (key == "cum_bytes") {
+			gotCumBytes = !!(valueStream >> position.cumBytes);
+		}
+	}
+
+	if (captureFile.empty() || !gotFrameCount || !gotOffset || !gotCumBytes) {
+		return INVALID;
+	}
+
+	return LOADED;
+}
+
+bool Checkpoint::isFrom(const char* path) const {
+	std::string lhs = getCanonicalPath(captureFile.c_str());
+	std::string rhs = getCanonicalPath(path);
+
+#ifdef _WIN32
+	//Windows paths aren't case sensitive, and _fullpath leaves the case as it was
+	return ::_stricmp(lhs.c_str(), rhs.c_str()) == 0;
+#else
+	return lhs == rhs;
+#endif
+}
+
+std::string Checkpoint::getCanonicalPath(const char* path) {
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (::_fullpath(buffer, path, sizeof(buffer))) {
+		return buffer;
+	}
+#else
+	char* resolved = ::realpath(path, NULL);
+	if (resolved) {
+		std::string canonical = resolved;
+		::free(resolved);
+		return canonical;
+	}
+#endif
+
+	return path;
+}
+
+bool Checkpoint::isCheckpointFile(const char* path) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	std::string line;
+	return std::getline(file, line) && line == CHECKPOINT_HEADER;
+}
+
+bool Checkpoint::save(const char* path) const {
+	//Write to a temporary file and move it into place, so there's always a complete checkpoint on disk
+	std::string tempPath = path;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream file(tempPath.c_str(), std::ios::out | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+
+		file << CHECKPOINT_HEADER << "\n"
+			<< "capture_file " << captureFile << "\n"
+			<< "frame_count " << frameCount << "\n"
+			<< "last_record_offset " << static_cast<long long>(position.lastRecordOffset) << "\n"
+			<< "cum_bytes " << position.cumBytes << "\n";
+
+		file.flush();
+		if (!file) {
+			file.close();
+			::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	//rename won't replace an existing file on Windows
+	::remove(path);
+#endif
+	if (::rename(tempPath.c_str(), path) != 0) {
+		::remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "RubyAndShit.h"
+#include "RecordReader.h"
+
+#include <string>
+
+/** How many frames are read between checkpoints, unless set_checkpoint_file says otherwise */
+#define DEFAULT_CHECKPOINT_INTERVAL             10000
+
+/** A record of how far a sequential pass through a capture file got, saved periodically so a later run
+ *  can pick up where this one left off rather than starting again from frame 1.
+ *
+ *  Checkpoints are small text files, replaced atomically each time they're written, so a crash
+ *  mid-write leaves the previous checkpoint intact */
+struct Checkpoint {
+	/** Outcomes of load() */
+	enum LoadResult {
+		LOADED,
+		NOT_FOUND,
+		INVALID
+	};
+
+	Checkpoint(void);
+
+	/** Loads the checkpoint at 'path' */
+	LoadResult load(const char* path);
+
+	/** Writes this checkpoint to 'path', returning false if it couldn't be written */
+	bool save(const char* path) const;
+
+	/** True if the file at 'path' is a checkpoint, or the temporary copy of one that save() writes first.
+	Checkpoints can be named anything, so this goes by what's in the file rather than its name */
+	static bool isCheckpointFile(const char* path);
+
+	/** True if the checkpoint was taken from 'path', however each of them names the file */
+	bool isFrom(const char* path) const;
+
+	/** Resolves 'path' to an absolute path with no symbolic links, so the same file is named the same way
+	whatever the working directory.  Returns 'path' as it is if it can't be resolved */
+	static std::string getCanonicalPath(const char* path);
+
+	/** The capture file the checkpoint was taken from, as a canonical path for checkpoints saved by this
+	version; older ones have the path as it was given */
+	std::string captureFile;
+
+	/** The number of frames that had been read, and so the number of the last frame processed */
+	guint32 frameCount;
+
+	/** The sequential reader's position after the last frame processed */
+	ReadPosition position;
+};
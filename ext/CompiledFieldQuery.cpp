@@ -0,0 +1,330 @@
+#include "CompiledFieldQuery.h"
+#include "FieldQuery.h"
+
+#include <algorithm>
+
+//Need some dissector constants
+extern "C" {
+#include "epan/dissectors/packet-frame.h"
+#include "epan/dissectors/packet-data.h"
+}
+
+VALUE CompiledFieldQuery::createClass() {
+    //Define the 'CompiledFieldQuery' class.  Instances come only from FieldQuery.compile
+	VALUE klass = rb_define_class_under(g_cap_dissector_module, "CompiledFieldQuery", rb_cObject);
+	::rb_undef_method(CLASS_OF(klass), "new");
+
+	return klass;
+}
+
+VALUE CompiledFieldQuery::compile(VALUE klass, VALUE conditions) {
+	//Wrap the query before compiling into it, so it's freed by the GC if a condition is rejected
+	CompiledFieldQuery* query = new CompiledFieldQuery();
+	VALUE rubyQuery = Data_Wrap_Struct(g_compiled_field_query_class, NULL, CompiledFieldQuery::free, query);
+
+	query->addConditions(conditions);
+
+	return rubyQuery;
+}
+
+CompiledFieldQuery* CompiledFieldQuery::fromRubyObject(VALUE query) {
+	if (TYPE(query) != T_DATA ||
+		RDATA(query)->dfree != (RUBY_DATA_FUNC)CompiledFieldQuery::free) {
+		return NULL;
+	}
+
+	CompiledFieldQuery* compiled = NULL;
+	Data_Get_Struct(query, CompiledFieldQuery, compiled);
+	return compiled;
+}
+
+bool CompiledFieldQuery::matches(Packet& packet, ProtocolTreeNode& node) {
+	const header_field_info* hfinfo = PITEM_FINFO(node.getProtoNode())->hfinfo;
+
+	HfVerdict verdict = getHfVerdict(packet, node, hfinfo);
+	if (verdict == HF_REJECTS) {
+		return false;
+	}
+
+	//The invariant predicates have all passed, for this node or an earlier one with the same header field,
+	//unless the verdict is unknown, in which case none of them have been evaluated yet
+	for (PredicateVector::iterator iter = _predicates.begin();
+		iter != _predicates.end();
+		++iter) {
+		if ((verdict == HF_UNKNOWN || !isHfInvariant(*iter, hfinfo)) &&
+			!predicateMatches(*iter, packet, node)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+CompiledFieldQuery::CompiledFieldQuery() {
+}
+
+CompiledFieldQuery::~CompiledFieldQuery(void) {
+	for (PredicateVector::iterator iter = _predicates.begin();
+		iter != _predicates.end();
+		++iter) {
+		for (std::vector<CompiledFieldQuery*>::iterator nested = iter->nested.begin();
+			nested != iter->nested.end();
+			++nested) {
+			delete *nested;
+		}
+
+		delete iter->pattern;
+	}
+}
+
+void CompiledFieldQuery::free(void* p) {
+	CompiledFieldQuery* query = reinterpret_cast<CompiledFieldQuery*>(p);
+	delete query;
+}
+
+void CompiledFieldQuery::addConditions(VALUE conditions) {
+	if (TYPE(conditions) != T_HASH) {
+		::rb_raise(::rb_eTypeError, "wrong argument type %s (expected Hash)",
+			::rb_obj_classname(conditions));
+	}
+
+	VALUE keys = ::rb_funcall(conditions, ::rb_intern("keys"), 0);
+	for (long idx = 0; idx < RARRAY(keys)->len; idx++) {
+		VALUE key = RARRAY(keys)->ptr[idx];
+		const char* keyName = SYMBOL_P(key) ? ::rb_id2name(SYM2ID(key)) : RSTRING(::StringValue(key))->ptr;
+
+		addCondition(keyName, ::rb_hash_aref(conditions, key));
+	}
+
+	std::stable_sort(_predicates.begin(), _predicates.end(), CompiledFieldQuery::isCheaper);
+}
+
+void CompiledFieldQuery::addCondition(const char* key, VALUE operand) {
+	static const struct {
+		const char* key;
+		PredicateType type;
+	} CONDITIONS[] = {
+		{"name", NAME_IS},
+		{"name_matches", NAME_MATCHES},
+		{"value", VALUE_IS},
+		{"value_starts_with", VALUE_STARTS_WITH},
+		{"value_contains", VALUE_CONTAINS},
+		{"display_name", DISPLAY_NAME_IS},
+		{"display_value", DISPLAY_VALUE_IS},
+		{"display_value_matches", DISPLAY_VALUE_MATCHES},
+		{"sibling_name", SIBLING_NAME_IS},
+		{"sibling", SIBLING_MATCHES},
+		{"has_display_name", HAS_DISPLAY_NAME},
+		{"has_value", HAS_VALUE},
+		{"has_display_value", HAS_DISPLAY_VALUE},
+		{"any", ANY_MATCHES}
+	};
+
+	size_t idx = 0;
+	size_t numConditions = sizeof(CONDITIONS) / sizeof(CONDITIONS[0]);
+	while (idx < numConditions && ::strcmp(CONDITIONS[idx].key, key) != 0) {
+		idx++;
+	}
+
+	if (idx == numConditions) {
+		::rb_raise(::rb_eArgError, "'%s' is not a known field query condition", key);
+	}
+
+	Predicate predicate;
+	predicate.type = CONDITIONS[idx].type;
+	predicate.expected = true;
+	predicate.pattern = NULL;
+
+	switch (predicate.type) {
+	case NAME_IS:
+	case DISPLAY_NAME_IS:
+	case DISPLAY_VALUE_IS:
+	case SIBLING_NAME_IS:
+		operand = ::StringValue(operand);
+		predicate.operand.assign(RSTRING(operand)->ptr, RSTRING(operand)->len);
+		break;
+
+	case VALUE_IS:
+	case VALUE_STARTS_WITH:
+	case VALUE_CONTAINS:
+		if (TYPE(operand) == T_STRING) {
+			predicate.operand.assign(RSTRING(operand)->ptr, RSTRING(operand)->len);
+		} else {
+			VALUE bytes = ::rb_check_array_type(operand);
+			if (NIL_P(bytes)) {
+				::rb_raise(::rb_eTypeError, "the '%s' condition must be a String or an Array of bytes", key);
+			}
+			for (long byteIdx = 0; byteIdx < RARRAY(bytes)->len; byteIdx++) {
+				predicate.operand += static_cast<char>(NUM2INT(RARRAY(bytes)->ptr[byteIdx]));
+			}
+		}
+		break;
+
+	case HAS_DISPLAY_NAME:
+	case HAS_VALUE:
+	case HAS_DISPLAY_VALUE:
+		predicate.expected = RTEST(operand) ? true : false;
+		break;
+
+	case NAME_MATCHES:
+	case DISPLAY_VALUE_MATCHES:
+		predicate.pattern = PatternMatcher::compile(operand);
+		break;
+
+	case SIBLING_MATCHES:
+		_predicates.push_back(predicate);
+		addNestedQuery(_predicates.back(), operand);
+		return;
+
+	case ANY_MATCHES:
+		{
+			VALUE alternatives = ::rb_check_array_type(operand);
+			if (NIL_P(alternatives)) {
+				::rb_raise(::rb_eTypeError, "the 'any' condition must be an Array of Hashes");
+			}
+
+			_predicates.push_back(predicate);
+			for (long altIdx = 0; altIdx < RARRAY(alternatives)->len; altIdx++) {
+				addNestedQuery(_predicates.back(), RARRAY(alternatives)->ptr[altIdx]);
+			}
+		}
+		return;
+	}
+
+	_predicates.push_back(predicate);
+}
+
+void CompiledFieldQuery::addNestedQuery(Predicate& predicate, VALUE conditions) {
+	CompiledFieldQuery* nested = new CompiledFieldQuery();
+	predicate.nested.push_back(nested);
+
+	nested->addConditions(conditions);
+}
+
+bool CompiledFieldQuery::isHfInvariant(const Predicate& predicate, const header_field_info* hfinfo) {
+	switch (predicate.type) {
+	case NAME_IS:
+	case NAME_MATCHES:
+		//ProtocolTreeNode takes the name from the header field
+		return true;
+
+	case HAS_DISPLAY_NAME:
+	case DISPLAY_NAME_IS:
+		//Text items and data have no display name
+		return hfinfo->id == hf_text_only || hfinfo->id == proto_data;
+
+	case HAS_DISPLAY_VALUE:
+	case DISPLAY_VALUE_IS:
+	case DISPLAY_VALUE_MATCHES:
+		//Text items take their display value from their label, but data, protocols and FT_NONE fields have none
+		return hfinfo->id != hf_text_only &&
+			(hfinfo->id == proto_data || hfinfo->type == FT_PROTOCOL || hfinfo->type == FT_NONE);
+
+	default:
+		return false;
+	}
+}
+
+CompiledFieldQuery::HfVerdict CompiledFieldQuery::getHfVerdict(Packet& packet, ProtocolTreeNode& node, const header_field_info* hfinfo) {
+	if (hfinfo->id < 0) {
+		//Not a registered header field, so there's nowhere to remember the outcome
+		return HF_UNKNOWN;
+	}
+
+	size_t hfId = static_cast<size_t>(hfinfo->id);
+	if (hfId >= _hfVerdicts.size()) {
+		_hfVerdicts.resize(hfId + 1, HF_UNKNOWN);
+	}
+
+	if (_hfVerdicts[hfId] == HF_UNKNOWN) {
+		HfVerdict verdict = HF_PASSES;
+
+		for (PredicateVector::iterator iter = _predicates.begin();
+			iter != _predicates.end();
+			++iter) {
+			if (isHfInvariant(*iter, hfinfo) &&
+				!predicateMatches(*iter, packet, node)) {
+				verdict = HF_REJECTS;
+				break;
+			}
+		}
+
+		_hfVerdicts[hfId] = static_cast<guint8>(verdict);
+	}
+
+	return static_cast<HfVerdict>(_hfVerdicts[hfId]);
+}
+
+bool CompiledFieldQuery::predicateMatches(const Predicate& predicate, Packet& packet, ProtocolTreeNode& node) {
+	switch (predicate.type) {
+	case NAME_IS:
+		return FieldQuery::stringMatches(predicate.operand.data(), predicate.operand.length(), node.getName());
+
+	case NAME_MATCHES:
+		return predicate.pattern->matches(node.getName());
+
+	case HAS_VALUE:
+		return (node.getValue() != NULL) == predicate.expected;
+
+	case VALUE_IS:
+	case VALUE_STARTS_WITH:
+	case VALUE_CONTAINS:
+		return FieldQuery::bytesMatch(predicate.type == VALUE_IS ? FieldQuery::BYTES_MATCH :
+				(predicate.type == VALUE_STARTS_WITH ? FieldQuery::BYTES_START_WITH : FieldQuery::BYTES_CONTAIN),
+			reinterpret_cast<const guchar*>(predicate.operand.data()), 
+			predicate.operand.length(), 
+			node.getValue(), 
+			node.getFieldLength());
+
+	case HAS_DISPLAY_NAME:
+		{
+			const gchar* displayName = node.getDisplayName();
+			return (displayName != NULL && *displayName != '\0') == predicate.expected;
+		}
+
+	case DISPLAY_NAME_IS:
+		return FieldQuery::stringMatches(predicate.operand.data(), predicate.operand.length(), node.getDisplayName());
+
+	case HAS_DISPLAY_VALUE:
+		{
+			const gchar* displayValue = node.getDisplayValue();
+			return (displayValue != NULL && *displayValue != '\0') == predicate.expected;
+		}
+
+	case DISPLAY_VALUE_IS:
+		return FieldQuery::stringMatches(predicate.operand.data(), predicate.operand.length(), node.getDisplayValue());
+
+	case DISPLAY_VALUE_MATCHES:
+		return predicate.pattern->matches(node.getDisplayValue());
+
+	case SIBLING_NAME_IS:
+	case SIBLING_MATCHES:
+		for (ProtocolTreeNode* sibling = packet.getFirstSibling(node);
+			sibling != NULL;
+			sibling = packet.getNextSibling(*sibling)) {
+			//Don't include this node itself in the comparison
+			if (sibling == &node) {
+				continue;
+			}
+
+			if (predicate.type == SIBLING_NAME_IS ?
+				FieldQuery::stringMatches(predicate.operand.data(), predicate.operand.length(), sibling->getName()) :
+				predicate.nested.front()->matches(packet, *sibling)) {
+				return true;
+			}
+		}
+		return false;
+
+	case ANY_MATCHES:
+		for (std::vector<CompiledFieldQuery*>::const_iterator iter = predicate.nested.begin();
+			iter != predicate.nested.end();
+			++iter) {
+			if ((*iter)->matches(packet, node)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	return false;
+}
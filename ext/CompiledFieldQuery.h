@@ -0,0 +1,135 @@
+#pragma once
+
+#include "RubyAndShit.h"
+
+#include <string>
+#include <vector>
+
+#include "NativePacket.h"
+#include "ProtocolTreeNode.h"
+#include "PatternMatcher.h"
+
+/** A field query compiled from a Hash of conditions by FieldQuery.compile, which Packet's field matching
+methods evaluate natively over the node table instead of calling a query proc for each node.
+
+Each key of the Hash is a condition the field must meet, and the field matches if it meets them all:
+
+  :name => 'wlan_mgt.tag.number'        like FieldQuery#name_is?
+  :name_matches => 'wlan_mgt.tag.*'     like FieldQuery#name_matches?, with a glob String or a Regexp
+  :value => "\x00" or [0]               like FieldQuery#value_is?, taking the bytes from a String or an Array
+  :value_starts_with => "GET "          like FieldQuery#value_starts_with?, ditto
+  :value_contains => "\r\n\r\n"         like FieldQuery#value_contains?, ditto
+  :display_name => '...'                like FieldQuery#display_name_is?
+  :display_value => '...'               like FieldQuery#display_value_is?
+  :display_value_matches => /wsj\.com$/ like FieldQuery#display_value_matches?, ditto
+  :sibling_name => '...'                like FieldQuery#sibling_name_is?
+  :sibling => { conditions }            like FieldQuery#sibling_matches?, with a nested query
+  :has_display_name => true or false    like FieldQuery#has_display_name?, or its negation
+  :has_value => true or false           like FieldQuery#has_value?, or its negation
+  :has_display_value => true or false   like FieldQuery#has_display_value?, or its negation
+  :any => [ { conditions }, ... ]       matches if any of the nested queries does
+
+The comparisons are the same ones the FieldQuery predicates make, so a compiled query selects the same fields
+as the equivalent proc.  Conditions are evaluated cheapest first, whatever order they're written in.
+
+Some conditions depend only on a field's header field, such as its name, so the query remembers for each header
+field id whether those conditions passed.  Once one field of a kind has been seen, later fields of the same kind,
+in this packet or any other, are rejected without evaluating anything, or are checked against just the
+conditions that vary from field to field */
+class CompiledFieldQuery
+{
+public:
+	static VALUE createClass();
+
+	/** Implements FieldQuery.compile; raises ArgumentError on a condition it doesn't recognize */
+	static VALUE compile(VALUE klass, VALUE conditions);
+
+	/** Gets the native object behind a Ruby CompiledFieldQuery object, or NULL if 'query' isn't one */
+	static CompiledFieldQuery* fromRubyObject(VALUE query);
+
+	/** True if the node meets every condition of the query */
+	bool matches(Packet& packet, ProtocolTreeNode& node);
+
+private:
+	/** The kinds of condition, in the order they're evaluated, cheapest first */
+	enum PredicateType {
+		NAME_IS,
+		NAME_MATCHES,
+		HAS_VALUE,
+		VALUE_IS,
+		VALUE_STARTS_WITH,
+		VALUE_CONTAINS,
+		HAS_DISPLAY_NAME,
+		DISPLAY_NAME_IS,
+		HAS_DISPLAY_VALUE,
+		DISPLAY_VALUE_IS,
+		DISPLAY_VALUE_MATCHES,
+		SIBLING_NAME_IS,
+		SIBLING_MATCHES,
+		ANY_MATCHES
+	};
+
+	struct Predicate {
+		PredicateType type;
+
+		/** The string or bytes compared against, for the comparison predicates */
+		std::string operand;
+
+		/** The answer wanted from the has_* predicates */
+		bool expected;
+
+		/** The compiled pattern of the *_MATCHES predicates; owned by the query that contains the predicate */
+		PatternMatcher* pattern;
+
+		/** The nested queries of SIBLING_MATCHES and ANY_MATCHES; owned by the query that contains the predicate */
+		std::vector<CompiledFieldQuery*> nested;
+	};
+
+	typedef std::vector<Predicate> PredicateVector;
+
+	/** What's known about the conditions that depend only on the header field, for each header field id */
+	enum HfVerdict {
+		HF_UNKNOWN = 0,
+		HF_REJECTS,
+		HF_PASSES
+	};
+
+	typedef std::vector<guint8> HfVerdictVector;
+
+	CompiledFieldQuery();
+	virtual ~CompiledFieldQuery(void);
+
+	//No copy ctor, and no assignment
+	CompiledFieldQuery(const CompiledFieldQuery&);
+	CompiledFieldQuery& operator=(const CompiledFieldQuery&);
+
+	static void free(void* p);
+
+	/** Adds the predicates for a Hash of conditions, recursing into nested queries.  Each nested query is owned
+	by this one before it's filled in, so nothing leaks if a condition turns out to be invalid */
+	void addConditions(VALUE conditions);
+
+	/** Adds the predicate for a single condition */
+	void addCondition(const char* key, VALUE operand);
+
+	/** Adds a nested query compiled from 'conditions' to a predicate that's already been added */
+	void addNestedQuery(Predicate& predicate, VALUE conditions);
+
+	/** Orders a condition before any that cost more to evaluate */
+	static bool isCheaper(const Predicate& lhs, const Predicate& rhs) { return lhs.type < rhs.type; }
+
+	/** True if a predicate's outcome is the same for every field with the header field 'hfinfo' */
+	static bool isHfInvariant(const Predicate& predicate, const header_field_info* hfinfo);
+
+	/** Evaluates the header field invariant predicates against a node, the first time a node with its header field
+	is seen, and remembers the outcome.  Returns HF_UNKNOWN without evaluating anything for nodes with no registered
+	header field, such as text items */
+	HfVerdict getHfVerdict(Packet& packet, ProtocolTreeNode& node, const header_field_info* hfinfo);
+
+	bool predicateMatches(const Predicate& predicate, Packet& packet, ProtocolTreeNode& node);
+
+	PredicateVector _predicates;
+
+	/** Indexed by header field id; grown as ids are seen */
+	HfVerdictVector _hfVerdicts;
+};
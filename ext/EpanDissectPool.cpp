@@ -0,0 +1,69 @@
+#include "EpanDissectPool.h"
+
+EpanDissectPool::EpanDissectPool(void)
+{
+	_allocationCount = 0;
+	_acquisitionCount = 0;
+	_refCount = 1;
+}
+
+EpanDissectPool::~EpanDissectPool(void)
+{
+	for (std::vector<epan_dissect_t*>::iterator iter = _free.begin();
+		iter != _free.end();
+		++iter) {
+		::g_free(*iter);
+	}
+	_free.clear();
+}
+
+void EpanDissectPool::removeRef() {
+	if (--_refCount == 0) {
+		delete this;
+	}
+}
+
+epan_dissect_t* EpanDissectPool::acquire(gboolean createProtoTree, gboolean protoTreeVisible) {
+	epan_dissect_t* edt = NULL;
+
+	if (_free.empty()) {
+		edt = g_new0(epan_dissect_t, 1);
+		_allocationCount++;
+	} else {
+		edt = _free.back();
+		_free.pop_back();
+	}
+	_acquisitionCount++;
+
+	//Same as epan_dissect_new; epan_dissect_run initializes the rest
+	if (createProtoTree) {
+		edt->tree = ::proto_tree_create_root();
+		::proto_tree_set_visible(edt->tree, protoTreeVisible);
+	} else {
+		edt->tree = NULL;
+	}
+	edt->tvb = NULL;
+
+	return edt;
+}
+
+void EpanDissectPool::release(epan_dissect_t* edt) {
+	//Same as epan_dissect_free, except for the g_free at the end
+	::free_data_sources(&edt->pi);
+
+	if (edt->tvb) {
+		::tvb_free_chain(edt->tvb);
+		edt->tvb = NULL;
+	}
+
+	if (edt->tree) {
+		::proto_tree_free(edt->tree);
+		edt->tree = NULL;
+	}
+
+	if (_free.size() < MAX_POOLED_DISSECTIONS) {
+		_free.push_back(edt);
+	} else {
+		::g_free(edt);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "RubyAndShit.h"
+
+#include <vector>
+
+/** The most released dissection contexts a pool holds on to; any more are freed outright */
+#define MAX_POOLED_DISSECTIONS                  256
+
+/** Recycles epan_dissect_t's from one packet to the next, rather than allocating and freeing one per frame.
+ *
+ *  Wireshark 1.0 has no epan_dissect_init/epan_dissect_cleanup, so release() does what epan_dissect_free
+ *  does short of freeing the structure itself: the protocol tree, tvbuffs and data sources go, and the
+ *  context is kept for the next packet, whose acquire() gives it a fresh tree root.
+ *
+ *  The pool is reference counted.  Its CapFile holds one reference, and each Packet holding one of its
+ *  contexts holds another, since the GC may free a CapFile before the packets it handed out */
+class EpanDissectPool
+{
+public:
+	/** Creates a pool with a single reference, held by the caller */
+	EpanDissectPool(void);
+
+	void addRef() { _refCount++; }
+
+	/** Drops a reference, deleting the pool and every context it's kept once the last one is gone */
+	void removeRef();
+
+	/** Gets a dissection context ready for epan_dissect_run; the equivalent of epan_dissect_new */
+	epan_dissect_t* acquire(gboolean createProtoTree, gboolean protoTreeVisible);
+
+	/** Cleans up after a dissection and keeps the context for reuse; the equivalent of epan_dissect_free */
+	void release(epan_dissect_t* edt);
+
+	/** The number of contexts allocated from the heap over the pool's lifetime */
+	guint64 getAllocationCount() const { return _allocationCount; }
+
+	/** The number of contexts handed out by acquire over the pool's lifetime */
+	guint64 getAcquisitionCount() const { return _acquisitionCount; }
+
+private:
+	/** Use removeRef */
+	virtual ~EpanDissectPool(void);
+
+	//No copy ctor, and no assignment
+	EpanDissectPool(const EpanDissectPool&);
+	EpanDissectPool& operator=(const EpanDissectPool&);
+
+	std::vector<epan_dissect_t*> _free;
+	guint64 _allocationCount;
+	guint64 _acquisitionCount;
+	guint _refCount;
+};
@@ -81,6 +81,10 @@ VALUE Field::createClass() {
                      "each_child", 
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(Field::each_child), 
 					 0);
+    rb_define_method(klass,
+                     "descendant_of?", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(Field::is_descendant_of), 
+					 1);
 	
     rb_define_method(klass,
                      "value_blob", 
@@ -277,6 +281,12 @@ VALUE Field::each_child(VALUE self) {
 	return field->eachChild();
 }
 
+VALUE Field::is_descendant_of(VALUE self, VALUE ancestor) {
+	Field* field = NULL;
+	Data_Get_Struct(self, Field, field);
+	return field->isDescendantOf(ancestor);
+}
+
 VALUE Field::value_blob(VALUE self) {
 	Field* field = NULL;
 	Data_Get_Struct(self, Field, field);
@@ -418,24 +428,41 @@ VALUE Field::getOrdinal() {
 }
 
 VALUE Field::getParent() {
-	return protocolTreeNodePtrToField(_packet->getProtocolTreeNodeFromProtoNode(_node->getProtoNode()->parent));
+	return protocolTreeNodePtrToField(_node->getParentNode());
 }
 
 VALUE Field::getNextSibling() {
-	return protocolTreeNodePtrToField(_packet->getProtocolTreeNodeFromProtoNode(_node->getProtoNode()->next));
+	return protocolTreeNodePtrToField(_packet->getNextSibling(*_node));
 }
 
 VALUE Field::eachChild() {
 	::rb_need_block();
 
-	proto_node* child = _node->getProtoNode()->first_child;
-	while (child) {
-		::rb_yield(protocolTreeNodePtrToField(_packet->getProtocolTreeNodeFromProtoNode(child)));
-		child = child->next;
+	for (ProtocolTreeNode* child = _packet->getFirstChild(*_node);
+		child != NULL;
+		child = _packet->getNextSibling(*child)) {
+		::rb_yield(protocolTreeNodePtrToField(child));
 	}
 	return _self;
 }
 
+VALUE Field::isDescendantOf(VALUE ancestor) {
+	if (::rb_obj_class(ancestor) != g_field_class) {
+		::rb_raise(::rb_eTypeError,
+			"The argument must be a Field");
+	}
+
+	Field* ancestorField = NULL;
+	Data_Get_Struct(ancestor, Field, ancestorField);
+
+	//Fields from different packets are never related
+	if (ancestorField->_packet != _packet) {
+		return Qfalse;
+	}
+
+	return _packet->isDescendant(*_node, *ancestorField->_node) ? Qtrue : Qfalse;
+}
+
 VALUE Field::getValueBlob() {
 	if (NIL_P(_rubyValueBlob)) {
 		const Blob* blob = _packet->getBlobByTvbuffPtr(_node->getProtoNode()->finfo->ds_tvb);
@@ -45,6 +45,7 @@ private:
 	static VALUE parent(VALUE self);
 	static VALUE next_sibling(VALUE self);
 	static VALUE each_child(VALUE self);
+	static VALUE is_descendant_of(VALUE self, VALUE ancestor);
 
 	static VALUE value_blob(VALUE self);
 	static VALUE value_blob_offset(VALUE self);
@@ -67,6 +68,7 @@ private:
 	VALUE getParent();
 	VALUE getNextSibling();
 	VALUE eachChild();
+	VALUE isDescendantOf(VALUE ancestor);
 
 	VALUE getValueBlob();
 	VALUE getValueBlobOffset();
@@ -97,6 +99,4 @@ private:
 	VALUE _rubyValueBlobLength;
 
 	Packet* _packet;
-
-	gchar _displayNameBuffer[ITEM_LABEL_LENGTH];
 };
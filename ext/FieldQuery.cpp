@@ -1,5 +1,8 @@
 #include "FieldQuery.h"
 #include "NativePointer.h"
+#include "CompiledFieldQuery.h"
+
+#include <vector>
 
 //Need some dissector constants
 extern "C" {
@@ -33,6 +36,16 @@ VALUE FieldQuery::createClass() {
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::value_is), 
 					 1);
 
+    rb_define_method(klass,
+                     "value_starts_with?", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::value_starts_with), 
+					 1);
+
+    rb_define_method(klass,
+                     "value_contains?", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::value_contains), 
+					 1);
+
     rb_define_method(klass,
                      "display_value_is?", 
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::display_value_is), 
@@ -43,6 +56,16 @@ VALUE FieldQuery::createClass() {
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::display_name_is), 
 					 1);
 
+    rb_define_method(klass,
+                     "name_matches?", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::name_matches), 
+					 1);
+
+    rb_define_method(klass,
+                     "display_value_matches?", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::display_value_matches), 
+					 1);
+
     rb_define_method(klass,
                      "sibling_name_is?", 
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::sibling_name_is), 
@@ -68,6 +91,12 @@ VALUE FieldQuery::createClass() {
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(FieldQuery::has_display_value), 
 					 0);
 
+    //Define the 'compile' class method, which builds a CompiledFieldQuery from a Hash of conditions
+    rb_define_singleton_method(klass,
+                     "compile", 
+					 reinterpret_cast<VALUE(*)(ANYARGS)>(CompiledFieldQuery::compile), 
+					 1);
+
 	return klass;
 }
 	
@@ -100,17 +129,10 @@ void FieldQuery::setFieldQueryCurrentNode(VALUE fieldQuery, ProtocolTreeNode* no
 }
 
 bool FieldQuery::passFieldToProc(VALUE fieldQueryObject, VALUE proc) {
-	//Ensure proc is in fact a proc
-	proc = FieldQuery::ensureIsProc(proc);
-
 	//Call the 'call' method on the proc object, passing in the field query object
 	VALUE retval = ::rb_funcall(proc, g_id_call, 1, fieldQueryObject);
 
-	if (retval == Qtrue || (retval != Qfalse && !NIL_P(retval))) {
-		return true;
-	} else {
-		return false;
-	}
+	return RTEST(retval) ? true : false;
 }
 
 void FieldQuery::setCurrentNode(ProtocolTreeNode* node) {
@@ -127,6 +149,17 @@ FieldQuery::FieldQuery() {
 }
 
 FieldQuery::~FieldQuery(void) {
+	for (GlobMap::iterator iter = _globs.begin();
+		iter != _globs.end();
+		++iter) {
+		delete iter->second;
+	}
+
+	for (RegexMap::iterator iter = _regexes.begin();
+		iter != _regexes.end();
+		++iter) {
+		delete iter->second;
+	}
 }
 	
 /*@ Methods implementing the FieldQuery Ruby object methods */
@@ -195,6 +228,18 @@ VALUE FieldQuery::value_is(VALUE self, VALUE match) {
 	return fieldQuery->getValueIs(match);
 }
 
+VALUE FieldQuery::value_starts_with(VALUE self, VALUE match) {
+	FieldQuery* fieldQuery = NULL;
+	Data_Get_Struct(self, FieldQuery, fieldQuery);
+	return fieldQuery->getValueStartsWith(match);
+}
+
+VALUE FieldQuery::value_contains(VALUE self, VALUE match) {
+	FieldQuery* fieldQuery = NULL;
+	Data_Get_Struct(self, FieldQuery, fieldQuery);
+	return fieldQuery->getValueContains(match);
+}
+
 VALUE FieldQuery::display_value_is(VALUE self, VALUE match) {
 	FieldQuery* fieldQuery = NULL;
 	Data_Get_Struct(self, FieldQuery, fieldQuery);
@@ -207,6 +252,18 @@ VALUE FieldQuery::display_name_is(VALUE self, VALUE match) {
 	return fieldQuery->getDisplayNameIs(match);
 }
 
+VALUE FieldQuery::name_matches(VALUE self, VALUE pattern) {
+	FieldQuery* fieldQuery = NULL;
+	Data_Get_Struct(self, FieldQuery, fieldQuery);
+	return fieldQuery->getNameMatches(pattern);
+}
+
+VALUE FieldQuery::display_value_matches(VALUE self, VALUE pattern) {
+	FieldQuery* fieldQuery = NULL;
+	Data_Get_Struct(self, FieldQuery, fieldQuery);
+	return fieldQuery->getDisplayValueMatches(pattern);
+}
+
 VALUE FieldQuery::sibling_name_is(VALUE self, VALUE match) {
 	FieldQuery* fieldQuery = NULL;
 	Data_Get_Struct(self, FieldQuery, fieldQuery);
@@ -241,6 +298,13 @@ void FieldQuery::mark() {
 	//If any of our Ruby versions of properties are set, mark them
 	if (_rubyPacket != Qnil) ::rb_gc_mark(_rubyPacket);
 	if (!NIL_P(_siblingsMatchesFieldQuery)) ::rb_gc_mark(_siblingsMatchesFieldQuery);
+
+	//The Regexps are looked up by identity, so they mustn't be collected and their addresses reused
+	for (RegexMap::iterator iter = _regexes.begin();
+		iter != _regexes.end();
+		++iter) {
+		::rb_gc_mark(iter->first);
+	}
 }
 
 VALUE FieldQuery::getField() {
@@ -254,47 +318,68 @@ VALUE FieldQuery::getNameIs(VALUE match) {
 	if (_currentNode == NULL) {
 		::rb_bug("name_is? called without a valid current node");
 	}
-	return compareStrings(match, _currentNode->getName());
+	return (compareStrings(match, _currentNode->getName()) ? Qtrue : Qfalse);
 }
 
 VALUE FieldQuery::getValueIs(VALUE match)  {
 	if (_currentNode == NULL) {
 		::rb_bug("value_is? called without a valid current node");
 	}
-	return compareByteArrays(match, _currentNode->getValue(), _currentNode->getFieldLength());
+	return (compareByteArrays(BYTES_MATCH, match, _currentNode->getValue(), _currentNode->getFieldLength()) ? Qtrue : Qfalse);
+}
+
+VALUE FieldQuery::getValueStartsWith(VALUE match)  {
+	if (_currentNode == NULL) {
+		::rb_bug("value_starts_with? called without a valid current node");
+	}
+	return (compareByteArrays(BYTES_START_WITH, match, _currentNode->getValue(), _currentNode->getFieldLength()) ? Qtrue : Qfalse);
+}
+
+VALUE FieldQuery::getValueContains(VALUE match)  {
+	if (_currentNode == NULL) {
+		::rb_bug("value_contains? called without a valid current node");
+	}
+	return (compareByteArrays(BYTES_CONTAIN, match, _currentNode->getValue(), _currentNode->getFieldLength()) ? Qtrue : Qfalse);
 }
 
 VALUE FieldQuery::getDisplayValueIs(VALUE match)  {
 	if (_currentNode == NULL) {
 		::rb_bug("display_value_is? called without a valid current node");
 	}
-	return compareStrings(match, _currentNode->getDisplayValue());
+	return (compareStrings(match, _currentNode->getDisplayValue()) ? Qtrue : Qfalse);
 }
 
 VALUE FieldQuery::getDisplayNameIs(VALUE match)  {
 	if (_currentNode == NULL) {
 		::rb_bug("display_name_is? called without a valid current node");
 	}
-	return compareStrings(match, _currentNode->getDisplayName());
+	return (compareStrings(match, _currentNode->getDisplayName()) ? Qtrue : Qfalse);
 }
 
-VALUE FieldQuery::getSiblingNameIs(VALUE match) {
+VALUE FieldQuery::getNameMatches(VALUE pattern)  {
 	if (_currentNode == NULL) {
-		::rb_bug("sibling_name_is? called without a valid current node");
+		::rb_bug("name_matches? called without a valid current node");
 	}
-	Packet::NodeParentMap::iterator lbound;
-	Packet::NodeParentMap::iterator ubound;
+	return (getPatternMatcher(pattern)->matches(_currentNode->getName()) ? Qtrue : Qfalse);
+}
 
-	_packet->getNodeSiblings(*_currentNode,
-		lbound,
-		ubound);
+VALUE FieldQuery::getDisplayValueMatches(VALUE pattern)  {
+	if (_currentNode == NULL) {
+		::rb_bug("display_value_matches? called without a valid current node");
+	}
+	return (getPatternMatcher(pattern)->matches(_currentNode->getDisplayValue()) ? Qtrue : Qfalse);
+}
 
-	for (Packet::NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
+VALUE FieldQuery::getSiblingNameIs(VALUE match) {
+	if (_currentNode == NULL) {
+		::rb_bug("sibling_name_is? called without a valid current node");
+	}
+	for (ProtocolTreeNode* sibling = _packet->getFirstSibling(*_currentNode);
+		sibling != NULL;
+		sibling = _packet->getNextSibling(*sibling)) {
 		//Don't include this node itself in the comparison
-		if (iter->second != _currentNode) {
-			if (compareStrings(match, iter->second->getName())) {
+		if (sibling != _currentNode) {
+			if (compareStrings(match, sibling->getName())) {
 				return Qtrue;
 			}
 		}
@@ -316,23 +401,16 @@ VALUE FieldQuery::getSiblingMatches(VALUE query)  {
 		_siblingsMatchesFieldQuery = FieldQuery::createFieldQuery(_rubyPacket);
 	}
 	
-	Packet::NodeParentMap::iterator lbound;
-	Packet::NodeParentMap::iterator ubound;
-
-	_packet->getNodeSiblings(*_currentNode,
-		lbound,
-		ubound);
-
-	for (Packet::NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
+	for (ProtocolTreeNode* sibling = _packet->getFirstSibling(*_currentNode);
+		sibling != NULL;
+		sibling = _packet->getNextSibling(*sibling)) {
 		//Don't include this node itself in the comparison
-		if (iter->second == _currentNode) {
+		if (sibling == _currentNode) {
 			continue;
 		}
 
 		//Pass this sibling FieldQuery object to the query proc
-		FieldQuery::setFieldQueryCurrentNode(_siblingsMatchesFieldQuery, iter->second);
+		FieldQuery::setFieldQueryCurrentNode(_siblingsMatchesFieldQuery, sibling);
 		if (passFieldToProc(_siblingsMatchesFieldQuery, proc)) {
 			//Query proc matches this field; that means at least one sibling of this field
 			//matches the query, so no further processing is needed
@@ -371,37 +449,108 @@ bool FieldQuery::compareStrings(VALUE rubyString, const char* nativeString, bool
 	if (rubyString == Qnil) {
 		//Ruby string value is null, or is some object that can't be converted to a string
 		return nativeString == NULL || *nativeString == '\0';
-	} else if (nativeString == NULL) {
-		//Native string is NULL, obviously Ruby string isn't, so it must be zero length to match
-		return RSTRING(rubyString)->len == 0;
 	}
 
-	const char* compareString = RSTRING(rubyString)->ptr;
-	size_t length = RSTRING(rubyString)->len;
+	return stringMatches(RSTRING(rubyString)->ptr, RSTRING(rubyString)->len, nativeString, caseSensitive);
+}
+
+bool FieldQuery::stringMatches(const char* match, size_t matchLength, const char* nativeString, bool caseSensitive /* = true */) {
+	if (nativeString == NULL) {
+		//Native string is NULL, so the match string must be zero length to match
+		return matchLength == 0;
+	}
 
 	if (!caseSensitive) {
-		return ::strncasecmp(compareString, nativeString, length) == 0;
+		return ::strncasecmp(match, nativeString, matchLength) == 0;
 	} else {
-		return ::strncmp(compareString, nativeString, length) == 0;
+		return ::strncmp(match, nativeString, matchLength) == 0;
 	}
 }
 
-bool FieldQuery::compareByteArrays(VALUE rubyAry, const guchar* nativeArray, guint nativeArrayLength) {
-	VALUE ary = ::rb_check_array_type(rubyAry);
+bool FieldQuery::compareByteArrays(ByteComparison comparison, VALUE rubyBytes, const guchar* nativeArray, guint nativeArrayLength) {
+	if (TYPE(rubyBytes) == T_STRING) {
+		//Compare straight from the String's buffer
+		return bytesMatch(comparison,
+			reinterpret_cast<const guchar*>(RSTRING(rubyBytes)->ptr),
+			RSTRING(rubyBytes)->len,
+			nativeArray,
+			nativeArrayLength);
+	}
+
+	VALUE ary = ::rb_check_array_type(rubyBytes);
+	if (NIL_P(ary)) {
+		::rb_raise(rb_eTypeError, "wrong argument type %s (expected String or Array)",
+			 ::rb_obj_classname(rubyBytes));
+	}
 
 	guint length = RARRAY(ary)->len;
-	if (length != nativeArrayLength) {
+	if (comparison == BYTES_MATCH && length != nativeArrayLength) {
 		return false;
 	}
 
+	std::vector<guchar> bytes(length);
 	for (guint idx = 0; idx < length; idx++) {
-		unsigned char rubyByte = (unsigned char)NUM2INT(RARRAY(ary)->ptr[idx]);
-		if (rubyByte != nativeArray[idx]) {
-			return false;
+		bytes[idx] = (unsigned char)NUM2INT(RARRAY(ary)->ptr[idx]);
+	}
+
+	return bytesMatch(comparison, length ? &bytes[0] : NULL, length, nativeArray, nativeArrayLength);
+}
+
+bool FieldQuery::bytesMatch(ByteComparison comparison, const guchar* match, size_t matchLength, const guchar* nativeArray, guint nativeArrayLength) {
+	if (matchLength > nativeArrayLength ||
+		(comparison == BYTES_MATCH && matchLength != nativeArrayLength)) {
+		return false;
+	}
+
+	if (matchLength == 0) {
+		return true;
+	}
+
+	if (nativeArray == NULL) {
+		return false;
+	}
+
+	if (comparison == BYTES_CONTAIN) {
+		return findBytes(match, matchLength, nativeArray, nativeArrayLength) != NULL;
+	}
+
+	return ::memcmp(match, nativeArray, matchLength) == 0;
+}
+
+const guchar* FieldQuery::findBytes(const guchar* match, size_t matchLength, const guchar* nativeArray, guint nativeArrayLength) {
+	//memchr skips ahead to each candidate for the first byte a word at a time, and only there is the rest compared
+	const guchar* last = nativeArray + (nativeArrayLength - matchLength);
+
+	for (const guchar* candidate = nativeArray; candidate <= last; candidate++) {
+		candidate = static_cast<const guchar*>(::memchr(candidate, match[0], last - candidate + 1));
+		if (candidate == NULL) {
+			return NULL;
+		}
+
+		if (::memcmp(candidate + 1, match + 1, matchLength - 1) == 0) {
+			return candidate;
 		}
 	}
 
-	return true;
+	return NULL;
+}
+
+PatternMatcher* FieldQuery::getPatternMatcher(VALUE pattern) {
+	if (TYPE(pattern) == T_STRING) {
+		std::string glob(RSTRING(pattern)->ptr, RSTRING(pattern)->len);
+
+		GlobMap::iterator iter = _globs.find(glob);
+		if (iter == _globs.end()) {
+			iter = _globs.insert(GlobMap::value_type(glob, PatternMatcher::compile(pattern))).first;
+		}
+		return iter->second;
+	}
+
+	RegexMap::iterator iter = _regexes.find(pattern);
+	if (iter == _regexes.end()) {
+		iter = _regexes.insert(RegexMap::value_type(pattern, PatternMatcher::compile(pattern))).first;
+	}
+	return iter->second;
 }
 
 bool FieldQuery::isNotEmptyOrNull(const char* nativeString) {
@@ -4,6 +4,10 @@
 
 #include "NativePacket.h"
 #include "ProtocolTreeNode.h"
+#include "PatternMatcher.h"
+
+#include <map>
+#include <string>
 
 
 /** The FieldQuery class represents a single field within a packet when a query proc is being evaluated.
@@ -20,12 +24,32 @@ public:
 	/** Extracts the native FieldQuery object from a Ruby object and calls setCurrentNode passing in 'node' */
 	static void setFieldQueryCurrentNode(VALUE fieldQuery, ProtocolTreeNode* node);
 
-	/** Invokes the given Proc object passing the given FieldQuery object to the Proc.
-	If the Proc throws an FieldDoesNotMatchQueryError, the error is caught and this method returns
-	false.  If proc runs without any exceptions, returns true.  If proc raises some other exception, that exception
-	is re-raised and passed up the stack frame */
+	/** Invokes the given Proc object passing the given FieldQuery object to the Proc, and returns true if the Proc's
+	result is neither false nor nil.  The predicates return true or false rather than raising on a mismatch, so
+	a non-matching field costs no exception; any exception the Proc does raise is passed up the stack frame.
+	'proc' must already have been through ensureIsProc */
 	static bool passFieldToProc(VALUE fieldQueryObject, VALUE proc);
 
+	/** Ensures 'in' is of type Proc, attempting coercion if necessary.  Throws on error; returns Proc object on success.
+	Call it once per query, not once per field, since coercion creates a new Proc each time */
+	static VALUE ensureIsProc(VALUE in);
+
+	/** The string comparison behind name_is? and the other string predicates: true if nativeString starts
+	with the matchLength characters of 'match'.  Shared with CompiledFieldQuery, so compiled queries and
+	query procs agree */
+	static bool stringMatches(const char* match, size_t matchLength, const char* nativeString, bool caseSensitive = true);
+
+	/** The byte comparisons behind value_is?, value_starts_with? and value_contains? */
+	enum ByteComparison {
+		BYTES_MATCH,
+		BYTES_START_WITH,
+		BYTES_CONTAIN
+	};
+
+	/** True if nativeArray is identical to, starts with, or contains the matchLength bytes of 'match'.  Shared with
+	CompiledFieldQuery, like stringMatches */
+	static bool bytesMatch(ByteComparison comparison, const guchar* match, size_t matchLength, const guchar* nativeArray, guint nativeArrayLength);
+
 	/** Associates this object with the given node; all calls to the predicate methods will
 	evaluate the predicates in terms of this node (or 'Field' to Ruby callers) */
 	void setCurrentNode(ProtocolTreeNode* node);
@@ -50,8 +74,12 @@ private:
 
 	static VALUE name_is(VALUE self, VALUE match);
 	static VALUE value_is(VALUE self, VALUE match);
+	static VALUE value_starts_with(VALUE self, VALUE match);
+	static VALUE value_contains(VALUE self, VALUE match);
 	static VALUE display_value_is(VALUE self, VALUE match);
 	static VALUE display_name_is(VALUE self, VALUE match);
+	static VALUE name_matches(VALUE self, VALUE pattern);
+	static VALUE display_value_matches(VALUE self, VALUE pattern);
 	static VALUE sibling_name_is(VALUE self, VALUE match);
 	static VALUE sibling_matches(VALUE self, VALUE query);
 
@@ -65,8 +93,12 @@ private:
 	VALUE getField();
 	VALUE getNameIs(VALUE match);
 	VALUE getValueIs(VALUE match);
+	VALUE getValueStartsWith(VALUE match);
+	VALUE getValueContains(VALUE match);
 	VALUE getDisplayValueIs(VALUE match);
 	VALUE getDisplayNameIs(VALUE match);
+	VALUE getNameMatches(VALUE pattern);
+	VALUE getDisplayValueMatches(VALUE pattern);
 	VALUE getSiblingNameIs(VALUE match);
 	VALUE getSiblingMatches(VALUE query);
 
@@ -75,18 +107,16 @@ private:
 	VALUE getHasDisplayValue();
 
 	static bool compareStrings(VALUE rubyString, const char* nativeString, bool caseSensitive = true);
-	static bool compareByteArrays(VALUE rubyAry, const guchar* nativeArray, guint nativeArrayLength);
+	/** Compares a field's bytes with those of a binary String, or of an Array of Integers */
+	static bool compareByteArrays(ByteComparison comparison, VALUE rubyBytes, const guchar* nativeArray, guint nativeArrayLength);
+
+	/** Finds the first occurrence of the matchLength bytes of 'match' in nativeArray, or returns NULL */
+	static const guchar* findBytes(const guchar* match, size_t matchLength, const guchar* nativeArray, guint nativeArrayLength);
 	static bool isNotEmptyOrNull(const char* nativeString);
-	static void throwIfFalse(bool value) {
-		//Throw the FieldDoesNotMatchQueryError exception if value is false, indicating something
-		//didn't match
-		if (!value) {
-			::rb_raise(g_field_doesnt_match_error_class, "");
-		}
-	}
 
-	/** Ensures 'in' is of type Proc, attempting coercion if necessary.  Throws on error; returns Proc object on success */
-	static VALUE ensureIsProc(VALUE in);
+	/** Gets the compiled form of a pattern passed to name_matches? or display_value_matches?, compiling it the
+	first time it's seen */
+	PatternMatcher* getPatternMatcher(VALUE pattern);
 
 	VALUE _self;
 	VALUE _rubyPacket;
@@ -96,4 +126,12 @@ private:
 	/** Cached instance of FieldQuery object used to process sibling_matches? query predicates without
 	creating a new object each time */
 	VALUE _siblingsMatchesFieldQuery;
+
+	/** The patterns compiled for the query proc, kept for the rest of the search.  Globs are looked up by their
+	text, since a string literal is a new object each time the proc runs, but Regexps by identity, since a Regexp
+	literal is the same object every time */
+	typedef std::map<std::string, PatternMatcher*> GlobMap;
+	typedef std::map<VALUE, PatternMatcher*> RegexMap;
+	GlobMap _globs;
+	RegexMap _regexes;
 };
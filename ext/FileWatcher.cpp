@@ -0,0 +1,60 @@
+#include "FileWatcher.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+FileWatcher::FileWatcher(const char* filename)
+{
+	_inotifyFd = -1;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	_inotifyFd = ::inotify_init();
+	if (_inotifyFd >= 0) {
+		//Non-blocking, so the event queue can be drained without risk of hanging
+		::fcntl(_inotifyFd, F_SETFL, ::fcntl(_inotifyFd, F_GETFL) | O_NONBLOCK);
+
+		if (::inotify_add_watch(_inotifyFd, filename, IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+			//Not a local file, or out of watches; fall back on polling
+			::close(_inotifyFd);
+			_inotifyFd = -1;
+		}
+	}
+#else
+	filename;
+#endif
+}
+
+FileWatcher::~FileWatcher(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	if (_inotifyFd >= 0) {
+		::close(_inotifyFd);
+		_inotifyFd = -1;
+	}
+#endif
+}
+
+void FileWatcher::wait(long timeoutMsecs) {
+	struct timeval timeout;
+	timeout.tv_sec = timeoutMsecs / 1000;
+	timeout.tv_usec = (timeoutMsecs % 1000) * 1000;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (_inotifyFd >= 0) {
+		fd_set readFds;
+		FD_ZERO(&readFds);
+		FD_SET(_inotifyFd, &readFds);
+
+		if (::rb_thread_select(_inotifyFd + 1, &readFds, NULL, NULL, &timeout) > 0) {
+			//Discard the events; all that matters is that something happened
+			char events[4096];
+			while (::read(_inotifyFd, events, sizeof(events)) > 0) {
+			}
+		}
+		return;
+	}
+#endif
+
+	::rb_thread_wait_for(timeout);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "RubyAndShit.h"
+
+/** How long to wait for a capture file to grow before checking it again anyway, in milliseconds */
+#define FOLLOW_POLL_INTERVAL_MSECS              1000
+
+/** Waits for a file to be written to.  Uses inotify where it's available, and otherwise just sleeps
+ *  for the poll interval.  Either way the wait goes through the Ruby thread scheduler, so other Ruby
+ *  threads keep running while a capture file is being followed */
+class FileWatcher
+{
+public:
+	FileWatcher(const char* filename);
+	virtual ~FileWatcher(void);
+
+	/** Waits until the file is modified or 'timeoutMsecs' have elapsed, whichever is first.  Spurious wakeups
+	are possible, so callers should always check the file for themselves */
+	void wait(long timeoutMsecs);
+
+private:
+	//No copy ctor, and no assignment
+	FileWatcher(const FileWatcher&);
+	FileWatcher& operator=(const FileWatcher&);
+
+	/** The inotify instance, or -1 if inotify isn't available */
+	int _inotifyFd;
+};
@@ -0,0 +1,239 @@
+#include "FrameIndex.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+/** 'RCPX', which also serves as a byte order mark */
+#define FRAME_INDEX_MAGIC                       0x52435058
+/** Version 1 sidecars written from the memory-mapped reader hold offsets of record headers rather than of
+ *  frame data, so they're rebuilt */
+#define FRAME_INDEX_VERSION                     2
+
+FrameIndex::FrameIndex(void)
+{
+	_complete = false;
+}
+
+FrameIndex::~FrameIndex(void)
+{
+}
+
+FrameIndex* FrameIndex::load(const char* captureFile) {
+	gint64 captureSize = 0, captureMtime = 0;
+	if (!statCaptureFile(captureFile, captureSize, captureMtime)) {
+		return NULL;
+	}
+
+	std::string path = getSidecarPath(captureFile);
+	FILE* file = ::fopen(path.c_str(), "rb");
+	if (!file) {
+		return NULL;
+	}
+
+	FileHeader header;
+	FrameIndex* index = NULL;
+
+	if (::fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == FRAME_INDEX_MAGIC &&
+		header.version == FRAME_INDEX_VERSION &&
+		header.entrySize == sizeof(FrameIndexEntry) &&
+		header.captureSize == captureSize &&
+		header.captureMtime == captureMtime &&
+		header.frameCount <= G_MAXUINT32) {
+		index = new FrameIndex();
+		index->_entries.resize(static_cast<size_t>(header.frameCount));
+
+		if (header.frameCount == 0 ||
+			::fread(&index->_entries[0], sizeof(FrameIndexEntry), index->_entries.size(), file) == index->_entries.size()) {
+			index->_complete = true;
+		} else {
+			//Truncated
+			delete index;
+			index = NULL;
+		}
+	}
+
+	::fclose(file);
+
+	return index;
+}
+
+bool FrameIndex::save(const char* captureFile) const {
+	FileHeader header;
+	::memset(&header, 0, sizeof(header));
+
+	header.magic = FRAME_INDEX_MAGIC;
+	header.version = FRAME_INDEX_VERSION;
+	header.entrySize = sizeof(FrameIndexEntry);
+	header.frameCount = _entries.size();
+	if (!statCaptureFile(captureFile, header.captureSize, header.captureMtime)) {
+		return false;
+	}
+
+	//Write to a temporary file and move it into place, so a reader never sees a half-written index
+	std::string path = getSidecarPath(captureFile);
+	std::string tempPath = path + ".tmp";
+
+	FILE* file = ::fopen(tempPath.c_str(), "wb");
+	if (!file) {
+		//Most likely the capture is on a read-only volume
+		return false;
+	}
+
+	bool written = ::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(_entries.empty() ||
+			::fwrite(&_entries[0], sizeof(FrameIndexEntry), _entries.size(), file) == _entries.size());
+
+	if (::fclose(file) != 0) {
+		written = false;
+	}
+
+	if (written) {
+#ifdef _WIN32
+		//rename won't replace an existing file on Windows
+		::remove(path.c_str());
+#endif
+		written = ::rename(tempPath.c_str(), path.c_str()) == 0;
+	}
+
+	if (!written) {
+		::remove(tempPath.c_str());
+	}
+
+	return written;
+}
+
+guint32 FrameIndex::findFirstFrameAtOrAfter(gint64 secs, gint32 nsecs) const {
+	FrameIndexEntry value;
+	::memset(&value, 0, sizeof(value));
+	value.tsSecs = secs;
+	value.tsNsecs = nsecs;
+
+	EntryVector::const_iterator iter = std::lower_bound(_entries.begin(), _entries.end(), value, TimestampLess());
+
+	return static_cast<guint32>(iter - _entries.begin()) + 1;
+}
+
+void FrameIndex::swap(FrameIndex& other) {
+	_entries.swap(other._entries);
+	std::swap(_complete, other._complete);
+}
+
+void FrameIndex::append(const RawRecord& record) {
+	FrameIndexEntry entry;
+	::memset(&entry, 0, sizeof(entry));
+
+	entry.offset = record.offset;
+	entry.tsSecs = record.phdr->ts.secs;
+	entry.tsNsecs = record.phdr->ts.nsecs;
+	entry.caplen = record.phdr->caplen;
+	entry.len = record.phdr->len;
+	entry.encap = record.phdr->pkt_encap;
+
+	_entries.push_back(entry);
+}
+
+void FrameIndex::entryToPhdr(const FrameIndexEntry& entry, struct wtap_pkthdr& phdr) {
+	::memset(&phdr, 0, sizeof(phdr));
+
+	phdr.ts.secs = static_cast<time_t>(entry.tsSecs);
+	phdr.ts.nsecs = entry.tsNsecs;
+	phdr.caplen = entry.caplen;
+	phdr.len = entry.len;
+	phdr.pkt_encap = entry.encap;
+}
+
+bool FrameIndex::isSidecarPath(const char* path) {
+	static const char* suffixes[] = {FRAME_INDEX_SUFFIX, FRAME_INDEX_SUFFIX ".tmp"};
+
+	size_t pathLength = ::strlen(path);
+	for (size_t idx = 0; idx < sizeof(suffixes) / sizeof(suffixes[0]); idx++) {
+		size_t suffixLength = ::strlen(suffixes[idx]);
+		if (pathLength >= suffixLength && ::strcmp(path + pathLength - suffixLength, suffixes[idx]) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::string FrameIndex::getSidecarPath(const char* captureFile) {
+	std::string path = captureFile;
+	path += FRAME_INDEX_SUFFIX;
+
+	return path;
+}
+
+bool FrameIndex::statCaptureFile(const char* captureFile, gint64& size, gint64& mtime) {
+	struct stat st;
+	if (::stat(captureFile, &st) != 0) {
+		return false;
+	}
+
+	size = static_cast<gint64>(st.st_size);
+	mtime = static_cast<gint64>(st.st_mtime);
+
+	return true;
+}
+
+IndexingRecordReader::IndexingRecordReader(RecordReader* inner, FrameIndex& index, const char* captureFile) :
+	_index(index),
+	_captureFile(captureFile)
+{
+	_inner = inner;
+	_recordsRead = 0;
+	_savedFrameCount = 0;
+}
+
+IndexingRecordReader::~IndexingRecordReader(void)
+{
+	delete _inner;
+}
+
+gboolean IndexingRecordReader::readNext(RawRecord& record, int* err, gchar** errInfo) {
+	if (_inner->readNext(record, err, errInfo)) {
+		//The index may have been filled in by a separate scan of the file, in which case
+		//it already has this record
+		if (_recordsRead >= 0) {
+			_recordsRead++;
+			if (_recordsRead > static_cast<gint64>(_index.getFrameCount())) {
+				_index.append(record);
+			}
+		}
+		return TRUE;
+	}
+
+	if (*err == 0 && !_index.isComplete() && _recordsRead == static_cast<gint64>(_index.getFrameCount())) {
+		//Read all the way to the end without incident, so the index covers the whole file
+		_index.setComplete();
+		if (_index.getFrameCount() != _savedFrameCount) {
+			_index.save(_captureFile.c_str());
+			_savedFrameCount = _index.getFrameCount();
+		}
+	}
+
+	return FALSE;
+}
+
+bool IndexingRecordReader::seek(gint64 offset) {
+	if (!_inner->seek(offset)) {
+		return false;
+	}
+
+	//No telling which record number that was, so stop indexing
+	_recordsRead = -1;
+	return true;
+}
+
+bool IndexingRecordReader::refresh() {
+	if (!_inner->refresh()) {
+		return false;
+	}
+
+	if (_recordsRead >= 0) {
+		_index.setComplete(false);
+	}
+	return true;
+}
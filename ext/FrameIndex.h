@@ -0,0 +1,138 @@
+#pragma once
+
+#include "RubyAndShit.h"
+#include "RecordReader.h"
+
+#include <string>
+#include <vector>
+
+/** The suffix appended to a capture file's path to form the path of its index sidecar file */
+#define FRAME_INDEX_SUFFIX                      ".rcapidx"
+
+/** What the index records about each frame; enough to re-read the frame with wtap_seek_read and
+ *  rebuild its wtap_pkthdr without touching the rest of the file */
+struct FrameIndexEntry {
+	/** The offset of the frame's record, as returned by wtap_read */
+	gint64 offset;
+
+	gint64 tsSecs;
+	gint32 tsNsecs;
+
+	guint32 caplen;
+	guint32 len;
+	gint32 encap;
+};
+
+/** Index of the frames in a capture file, built when random access first needs it, and persisted in a
+ *  sidecar file next to the capture if CapFile#save_frame_index= asks for it, so later runs can jump
+ *  straight to any frame.
+ *
+ *  The sidecar is tagged with the capture file's size and modification time, and is ignored if
+ *  either has changed.  It's written in native byte order; an index written on a machine of the
+ *  other endianness is treated as stale and rebuilt */
+class FrameIndex
+{
+public:
+	FrameIndex(void);
+	virtual ~FrameIndex(void);
+
+	/** Loads the sidecar index for the given capture file.  Returns NULL if there isn't one, or if it's stale
+	or damaged */
+	static FrameIndex* load(const char* captureFile);
+
+	/** Writes this index to the given capture file's sidecar.  Returns false if it couldn't be written, which
+	isn't fatal; the index just won't survive this process */
+	bool save(const char* captureFile) const;
+
+	/** True if 'path' names a sidecar index, or the temporary file one is written to before it's moved into
+	place, rather than a capture file */
+	static bool isSidecarPath(const char* path);
+
+	/** Appends the next frame's record to the index */
+	void append(const RawRecord& record);
+
+	/** Marks the index as covering every frame in the capture file, or not */
+	void setComplete(bool complete = true) { _complete = complete; }
+	bool isComplete() const { return _complete; }
+
+	/** The number of frames indexed so far */
+	guint32 getFrameCount() const { return static_cast<guint32>(_entries.size()); }
+
+	/** Gets the entry for the frame with the given 1-based number, which must be <= getFrameCount() */
+	const FrameIndexEntry& getEntry(guint32 frameNumber) const { return _entries[frameNumber - 1]; }
+
+	/** Returns the 1-based number of the first frame whose timestamp is at or after the given time, or
+	getFrameCount() + 1 if there is none.  Binary searches the index, so it assumes the frames are in
+	timestamp order, as they are in any capture written by a single capture process */
+	guint32 findFirstFrameAtOrAfter(gint64 secs, gint32 nsecs) const;
+
+	/** Exchanges the contents of this index with another */
+	void swap(FrameIndex& other);
+
+	/** Fills in a wtap_pkthdr from an index entry */
+	static void entryToPhdr(const FrameIndexEntry& entry, struct wtap_pkthdr& phdr);
+
+private:
+	typedef std::vector<FrameIndexEntry> EntryVector;
+
+	/** Orders index entries by timestamp, for binary searching */
+	class TimestampLess {
+	public:
+		bool operator()(const FrameIndexEntry& entry, const FrameIndexEntry& value) const {
+			return entry.tsSecs < value.tsSecs ||
+				(entry.tsSecs == value.tsSecs && entry.tsNsecs < value.tsNsecs);
+		}
+	};
+
+	/** The fixed-size header at the start of the sidecar file */
+	struct FileHeader {
+		guint32 magic;
+		guint32 version;
+		guint32 entrySize;
+		guint32 reserved;
+		gint64 captureSize;
+		gint64 captureMtime;
+		guint64 frameCount;
+	};
+
+	static std::string getSidecarPath(const char* captureFile);
+
+	/** Gets the size and modification time of the capture file, returning false if it can't be stat'd */
+	static bool statCaptureFile(const char* captureFile, gint64& size, gint64& mtime);
+
+	EntryVector _entries;
+	bool _complete;
+};
+
+/** RecordReader which passes every record it reads from another reader through to the caller,
+ *  recording each one in a FrameIndex on the way.  When the inner reader reaches the end of the file
+ *  cleanly, the index is marked complete and saved */
+class IndexingRecordReader : public RecordReader
+{
+public:
+	/** Takes ownership of 'inner'; 'index' must outlive this reader */
+	IndexingRecordReader(RecordReader* inner, FrameIndex& index, const char* captureFile);
+	virtual ~IndexingRecordReader(void);
+
+	virtual gboolean readNext(RawRecord& record, int* err, gchar** errInfo);
+
+	virtual bool isRecordDataStable() const { return _inner->isRecordDataStable(); }
+
+	/** Seeking would leave a gap in the index, so once the reader has seeked it stops indexing.  An index that
+	wasn't already complete stays incomplete, and is rebuilt by scanning the file if it's needed */
+	virtual bool seek(gint64 offset);
+
+	/** If the file may have grown, the index no longer covers all of it */
+	virtual bool refresh();
+
+private:
+	RecordReader* _inner;
+	FrameIndex& _index;
+	std::string _captureFile;
+
+	/** The number of records read through this reader, or -1 once that's unknown because of a seek */
+	gint64 _recordsRead;
+
+	/** The number of frames in the index when it was last saved */
+	guint32 _savedFrameCount;
+};
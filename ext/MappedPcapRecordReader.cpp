@@ -0,0 +1,310 @@
+#include "MappedPcapRecordReader.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+/** Magic numbers found at the start of classic pcap files */
+#define PCAP_MAGIC                      0xa1b2c3d4
+#define PCAP_SWAPPED_MAGIC              0xd4c3b2a1
+#define PCAP_NSEC_MAGIC                 0xa1b23c4d
+#define PCAP_SWAPPED_NSEC_MAGIC         0x4d3cb2a1
+
+/** Sizes of the on-disk pcap file header and per-record header */
+#define PCAP_FILE_HEADER_LENGTH         24
+#define PCAP_RECORD_HEADER_LENGTH       16
+
+MappedPcapRecordReader* MappedPcapRecordReader::open(const char* filename, wtap* wth) {
+#ifdef HAVE_SYS_MMAN_H
+	//Let wiretap do the hard work of figuring out what kind of file this is.  Only the standard
+	//pcap formats have the fixed 16-byte record header we know how to parse; the patched/modified
+	//variants that share the same magic number are left to wiretap
+	int fileType = ::wtap_file_type(wth);
+	if (fileType != WTAP_FILE_PCAP && fileType != WTAP_FILE_PCAP_NSEC) {
+		return NULL;
+	}
+
+	int encap = ::wtap_file_encap(wth);
+	if (!isSupportedEncap(encap)) {
+		return NULL;
+	}
+
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < PCAP_FILE_HEADER_LENGTH) {
+		::close(fd);
+		return NULL;
+	}
+
+	//The mapping must cover the whole file; on 32-bit hosts huge files won't fit in the address
+	//space, in which case mmap fails and wiretap gets the job
+	size_t mapLength = static_cast<size_t>(st.st_size);
+	if (static_cast<off_t>(mapLength) != st.st_size) {
+		::close(fd);
+		return NULL;
+	}
+
+	void* map = ::mmap(NULL, mapLength, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		::close(fd);
+		return NULL;
+	}
+
+	//Records are consumed front to back, so ask the kernel for aggressive read-ahead and
+	//early reclaim of pages we've already passed
+	::madvise(map, mapLength, MADV_SEQUENTIAL);
+
+	MappedPcapRecordReader* reader = new MappedPcapRecordReader(fd,
+		reinterpret_cast<const guchar*>(map),
+		static_cast<gint64>(mapLength),
+		encap);
+	if (!reader->parseFileHeader()) {
+		//Compressed, or not what wiretap told us it was
+		delete reader;
+		return NULL;
+	}
+
+	return reader;
+#else
+	filename;
+	wth;
+	return NULL;
+#endif
+}
+
+MappedPcapRecordReader::MappedPcapRecordReader(int fd, const guchar* map, gint64 mapLength, int encap)
+{
+	_fd = fd;
+	_map = map;
+	_mapLength = mapLength;
+	_offset = PCAP_FILE_HEADER_LENGTH;
+	_byteSwapped = false;
+	_nanosecondTimestamps = false;
+	_versionMajor = 0;
+	_versionMinor = 0;
+
+	::memset(&_phdr, 0, sizeof(_phdr));
+	_phdr.pkt_encap = encap;
+
+	initPseudoHeader();
+}
+
+MappedPcapRecordReader::~MappedPcapRecordReader(void)
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (_map) {
+		::munmap(const_cast<guchar*>(_map), static_cast<size_t>(_mapLength));
+		_map = NULL;
+	}
+
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+#endif
+}
+
+gboolean MappedPcapRecordReader::readNext(RawRecord& record, int* err, gchar** errInfo) {
+	*err = 0;
+
+	if (_offset == _mapLength) {
+		//Nothing wrong, just at the end of the file
+		return FALSE;
+	}
+
+	if (_mapLength - _offset < PCAP_RECORD_HEADER_LENGTH) {
+		*err = WTAP_ERR_SHORT_READ;
+		return FALSE;
+	}
+
+	const guchar* hdr = _map + _offset;
+	guint32 tsSecs = readUint32(hdr);
+	guint32 tsFraction = readUint32(hdr + 4);
+	guint32 inclLen = readUint32(hdr + 8);
+	guint32 origLen = readUint32(hdr + 12);
+
+	//Same fix-up wiretap applies for files written by libpcap 0.4 and earlier, which
+	//had the two length fields swapped
+	if (_versionMajor == 2 &&
+		(_versionMinor < 3 || (_versionMinor == 3 && inclLen > origLen))) {
+		guint32 temp = origLen;
+		origLen = inclLen;
+		inclLen = temp;
+	}
+
+	if (inclLen > WTAP_MAX_PACKET_SIZE) {
+		*err = WTAP_ERR_BAD_RECORD;
+		*errInfo = ::g_strdup_printf("pcap: File has %u-byte packet, bigger than maximum of %u",
+			inclLen, WTAP_MAX_PACKET_SIZE);
+		return FALSE;
+	}
+
+	if (_mapLength - _offset - PCAP_RECORD_HEADER_LENGTH < inclLen) {
+		*err = WTAP_ERR_SHORT_READ;
+		return FALSE;
+	}
+
+	_phdr.ts.secs = tsSecs;
+	_phdr.ts.nsecs = _nanosecondTimestamps ? tsFraction : tsFraction * 1000;
+	_phdr.caplen = inclLen;
+	_phdr.len = origLen;
+
+	record.phdr = &_phdr;
+	record.pseudoHeader = &_pseudoHeader;
+	record.data = hdr + PCAP_RECORD_HEADER_LENGTH;
+
+	//Like wiretap's data_offset, which wtap_seek_read expects, this is the offset of the frame data
+	//following the record header, not of the header itself
+	record.offset = _offset + PCAP_RECORD_HEADER_LENGTH;
+
+	_offset += PCAP_RECORD_HEADER_LENGTH + inclLen;
+
+	return TRUE;
+}
+
+bool MappedPcapRecordReader::seek(gint64 offset) {
+	//'offset' is where the frame data starts, as reported in RawRecord::offset; back up to its record header
+	gint64 headerOffset = offset - PCAP_RECORD_HEADER_LENGTH;
+	if (headerOffset < PCAP_FILE_HEADER_LENGTH || headerOffset > _mapLength) {
+		return false;
+	}
+
+	_offset = headerOffset;
+	return true;
+}
+
+bool MappedPcapRecordReader::refresh() {
+#ifdef HAVE_SYS_MMAN_H
+	struct stat st;
+	if (::fstat(_fd, &st) != 0) {
+		return false;
+	}
+
+	if (st.st_size < _mapLength) {
+		//Truncated or replaced underneath us
+		return false;
+	} else if (st.st_size == _mapLength) {
+		//Nothing new yet
+		return true;
+	}
+
+	size_t mapLength = static_cast<size_t>(st.st_size);
+	if (static_cast<off_t>(mapLength) != st.st_size) {
+		return false;
+	}
+
+	//Frames from the old mapping are only referenced by packets that have already been freed,
+	//so it can go as soon as the new one is in place
+	void* map = ::mmap(NULL, mapLength, PROT_READ, MAP_SHARED, _fd, 0);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+
+	::munmap(const_cast<guchar*>(_map), static_cast<size_t>(_mapLength));
+	::madvise(map, mapLength, MADV_SEQUENTIAL);
+
+	_map = reinterpret_cast<const guchar*>(map);
+	_mapLength = static_cast<gint64>(mapLength);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool MappedPcapRecordReader::parseFileHeader() {
+	guint32 magic = *reinterpret_cast<const guint32*>(_map);
+
+	switch (magic) {
+	case PCAP_MAGIC:
+		_byteSwapped = false;
+		_nanosecondTimestamps = false;
+		break;
+
+	case PCAP_SWAPPED_MAGIC:
+		_byteSwapped = true;
+		_nanosecondTimestamps = false;
+		break;
+
+	case PCAP_NSEC_MAGIC:
+		_byteSwapped = false;
+		_nanosecondTimestamps = true;
+		break;
+
+	case PCAP_SWAPPED_NSEC_MAGIC:
+		_byteSwapped = true;
+		_nanosecondTimestamps = true;
+		break;
+
+	default:
+		return false;
+	}
+
+	_versionMajor = readUint16(_map + 4);
+	_versionMinor = readUint16(_map + 6);
+
+	return true;
+}
+
+guint32 MappedPcapRecordReader::readUint32(const guchar* ptr) const {
+	guint32 value;
+	::memcpy(&value, ptr, sizeof(value));
+	return _byteSwapped ? GUINT32_SWAP_LE_BE(value) : value;
+}
+
+guint16 MappedPcapRecordReader::readUint16(const guchar* ptr) const {
+	guint16 value;
+	::memcpy(&value, ptr, sizeof(value));
+	return _byteSwapped ? GUINT16_SWAP_LE_BE(value) : value;
+}
+
+void MappedPcapRecordReader::initPseudoHeader() {
+	::memset(&_pseudoHeader, 0, sizeof(_pseudoHeader));
+
+	switch (_phdr.pkt_encap) {
+	case WTAP_ENCAP_ETHERNET:
+		//We don't know whether there's an FCS in this frame or not
+		_pseudoHeader.eth.fcs_len = -1;
+		break;
+
+	case WTAP_ENCAP_IEEE_802_11:
+	case WTAP_ENCAP_PRISM_HEADER:
+	case WTAP_ENCAP_IEEE_802_11_WLAN_RADIOTAP:
+	case WTAP_ENCAP_IEEE_802_11_WLAN_AVS:
+		//Ditto for 802.11
+		_pseudoHeader.ieee_802_11.fcs_len = -1;
+		_pseudoHeader.ieee_802_11.channel = 0;
+		_pseudoHeader.ieee_802_11.data_rate = 0;
+		_pseudoHeader.ieee_802_11.signal_level = 0;
+		break;
+
+	default:
+		//No pseudo header
+		break;
+	}
+}
+
+bool MappedPcapRecordReader::isSupportedEncap(int encap) {
+	//Encapsulations whose pseudo header doesn't depend on the frame contents.  Others (ATM, IrDA,
+	//MTP2, LAPD, Bluetooth, ERF, ...) have wiretap parse a per-record header out of the frame, which
+	//we'd rather not duplicate
+	switch (encap) {
+	case WTAP_ENCAP_ETHERNET:
+	case WTAP_ENCAP_IEEE_802_11:
+	case WTAP_ENCAP_PRISM_HEADER:
+	case WTAP_ENCAP_IEEE_802_11_WLAN_RADIOTAP:
+	case WTAP_ENCAP_IEEE_802_11_WLAN_AVS:
+	case WTAP_ENCAP_RAW_IP:
+	case WTAP_ENCAP_NULL:
+	case WTAP_ENCAP_LOOP:
+	case WTAP_ENCAP_SLL:
+		return true;
+
+	default:
+		return false;
+	}
+}
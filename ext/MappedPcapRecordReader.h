@@ -0,0 +1,64 @@
+#pragma once
+
+#include "RecordReader.h"
+
+/** RecordReader for classic libpcap files on local disk, which maps the whole file into memory and hands
+ *  pointers to each frame straight to the dissectors.  This avoids both the read syscall per record and
+ *  the copy into the wiretap buffer that wtap_read does.
+ *
+ *  Only plain (uncompressed) pcap files with microsecond or nanosecond timestamps, in either byte order,
+ *  and only encapsulations for which wiretap fills in a constant pseudo header are handled.  For anything
+ *  else, open() returns NULL and the caller should fall back on WtapRecordReader */
+class MappedPcapRecordReader : public RecordReader
+{
+public:
+	/** Creates a reader for the given file, which must already have been opened successfully with
+	wtap_open_offline as 'wth'.  Returns NULL if the file isn't eligible for memory mapping */
+	static MappedPcapRecordReader* open(const char* filename, wtap* wth);
+
+	virtual ~MappedPcapRecordReader(void);
+
+	virtual gboolean readNext(RawRecord& record, int* err, gchar** errInfo);
+
+	/** Frames stay mapped until the reader is destroyed */
+	virtual bool isRecordDataStable() const { return true; }
+
+	virtual bool seek(gint64 offset);
+
+	/** Remaps the file if it has grown.  Since a partial record at the end of the file is never consumed,
+	it's simply read again once the rest of it has been written */
+	virtual bool refresh();
+
+private:
+	MappedPcapRecordReader(int fd, const guchar* map, gint64 mapLength, int encap);
+
+	/** Parses the pcap file header at the start of the mapping.  Returns false if it isn't a header
+	we know how to read */
+	bool parseFileHeader();
+
+	guint32 readUint32(const guchar* ptr) const;
+	guint16 readUint16(const guchar* ptr) const;
+
+	/** Fills in the pseudo header the same way wiretap's libpcap reader does for this encapsulation */
+	void initPseudoHeader();
+
+	/** Returns true if the mapped reader knows how to build the pseudo header for this encapsulation */
+	static bool isSupportedEncap(int encap);
+
+	/** The file descriptor is kept open so the file can be remapped if it grows */
+	int _fd;
+
+	const guchar* _map;
+	gint64 _mapLength;
+
+	/** The offset of the next record header within the mapping */
+	gint64 _offset;
+
+	bool _byteSwapped;
+	bool _nanosecondTimestamps;
+	guint16 _versionMajor;
+	guint16 _versionMinor;
+
+	struct wtap_pkthdr _phdr;
+	union wtap_pseudo_header _pseudoHeader;
+};
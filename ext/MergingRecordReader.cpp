@@ -0,0 +1,91 @@
+#include "MergingRecordReader.h"
+
+MergingRecordReader::MergingRecordReader(void)
+{
+	_started = false;
+	_current = NULL;
+}
+
+MergingRecordReader::~MergingRecordReader(void)
+{
+	for (MemberVector::iterator iter = _members.begin();
+		iter != _members.end();
+		++iter) {
+		Member* member = *iter;
+
+		//The reader may depend on the wiretap handle, so it goes first
+		delete member->reader;
+		::wtap_close(member->wth);
+		delete member;
+	}
+	_members.clear();
+}
+
+void MergingRecordReader::addMember(const char* filename, wtap* wth, RecordReader* reader) {
+	Member* member = new Member();
+	member->filename = filename;
+	member->wth = wth;
+	member->reader = reader;
+	member->index = _members.size();
+	::memset(&member->pending, 0, sizeof(member->pending));
+
+	_members.push_back(member);
+}
+
+gboolean MergingRecordReader::readNext(RawRecord& record, int* err, gchar** errInfo) {
+	*err = 0;
+
+	if (!_started) {
+		//Prime the heap with the first record of each file
+		_started = true;
+		for (MemberVector::iterator iter = _members.begin();
+			iter != _members.end();
+			++iter) {
+			if (!advance(*iter, err, errInfo)) {
+				return FALSE;
+			}
+		}
+	} else if (_current) {
+		//Done with the record handed out last time, so move that file along
+		Member* member = _current;
+		_current = NULL;
+		if (!advance(member, err, errInfo)) {
+			return FALSE;
+		}
+	}
+
+	if (_heap.empty()) {
+		//Every file is exhausted
+		return FALSE;
+	}
+
+	_current = _heap.top();
+	_heap.pop();
+
+	record = _current->pending;
+	return TRUE;
+}
+
+gboolean MergingRecordReader::advance(Member* member, int* err, gchar** errInfo) {
+	if (member->reader->readNext(member->pending, err, errInfo)) {
+		_heap.push(member);
+		return TRUE;
+	}
+
+	if (*err != 0) {
+		//Say which file the error came from, since the caller only knows about the set
+		gchar* memberInfo = ::g_strdup_printf("in \"%s\"%s%s",
+			member->filename.c_str(),
+			*errInfo ? ": " : "",
+			*errInfo ? *errInfo : "");
+		if (*errInfo) {
+			::g_free(*errInfo);
+		}
+		*errInfo = memberInfo;
+
+		return FALSE;
+	}
+
+	//This file is done; the rest carry on without it
+	return TRUE;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "RecordReader.h"
+
+#include <queue>
+#include <string>
+#include <vector>
+
+/** RecordReader which reads several capture files as if they were one, merging their records into
+ *  timestamp order as it goes.  Each file is read sequentially with its own reader, and only one record
+ *  per file is held at a time, so nothing is ever concatenated or buffered beyond that.
+ *
+ *  Records with identical timestamps come out in the order the files were given, so the files of a
+ *  ring buffer, listed in name order, come back in the order they were written */
+class MergingRecordReader : public RecordReader
+{
+public:
+	MergingRecordReader(void);
+	virtual ~MergingRecordReader(void);
+
+	/** Adds a file to the merge.  Takes ownership of both the wiretap handle and the reader, which must
+	read from it */
+	void addMember(const char* filename, wtap* wth, RecordReader* reader);
+
+	virtual gboolean readNext(RawRecord& record, int* err, gchar** errInfo);
+
+	/** Gets the wiretap handle of the first file in the set, which stands in for the set where
+	a single handle is needed */
+	wtap* getFirstWth() const { return _members.empty() ? NULL : _members[0]->wth; }
+
+	size_t getMemberCount() const { return _members.size(); }
+
+private:
+	/** One file in the merge, and the record it has waiting to be merged, if any */
+	struct Member {
+		std::string filename;
+		wtap* wth;
+		RecordReader* reader;
+		size_t index;
+		RawRecord pending;
+	};
+
+	/** Orders members so the one with the earliest pending record is at the top of the heap */
+	class MemberLater {
+	public:
+		bool operator()(const Member* lhs, const Member* rhs) const {
+			const struct wtap_nstime& lts = lhs->pending.phdr->ts;
+			const struct wtap_nstime& rts = rhs->pending.phdr->ts;
+
+			if (lts.secs != rts.secs) {
+				return lts.secs > rts.secs;
+			} else if (lts.nsecs != rts.nsecs) {
+				return lts.nsecs > rts.nsecs;
+			}
+
+			return lhs->index > rhs->index;
+		}
+	};
+
+	typedef std::vector<Member*> MemberVector;
+	typedef std::priority_queue<Member*, MemberVector, MemberLater> MemberHeap;
+
+	/** Reads the member's next record and, if there is one, puts the member back on the heap */
+	gboolean advance(Member* member, int* err, gchar** errInfo);
+
+	MemberVector _members;
+	MemberHeap _heap;
+
+	/** Members are primed lazily, on the first read */
+	bool _started;
+
+	/** The member whose record was returned by the last readNext; it's advanced on the next call, so
+	that record stays valid until then */
+	Member* _current;
+};
@@ -2,6 +2,7 @@
 #include "CapFile.h"
 #include "Field.h"
 #include "FieldQuery.h"
+#include "CompiledFieldQuery.h"
 
 //Need some dissector constants
 extern "C" {
@@ -59,6 +60,11 @@ VALUE Packet::createClass() {
                   reinterpret_cast<VALUE(*)(ANYARGS)>(Packet::info),
                   0);
 
+    rb_define_method(klass,
+                  "column",
+                  reinterpret_cast<VALUE(*)(ANYARGS)>(Packet::column),
+                  1);
+
     rb_define_method(klass,
                      "field_exists?", 
 					 reinterpret_cast<VALUE(*)(ANYARGS)>(Packet::field_exists), 
@@ -143,30 +149,38 @@ VALUE Packet::createClass() {
 #pragma warning(disable : 4702) //unreachable code
 #endif
 
-gboolean Packet::getNextPacket(VALUE capFileObject, capture_file& cf, VALUE& packet) {
+gboolean Packet::getNextPacket(VALUE capFileObject, capture_file& cf, RecordReader& reader, ReadPosition& position, VALUE& packet, gboolean keepFrameData /* = FALSE */, gboolean following /* = FALSE */) {
     int err = 0;
     gchar* err_info = NULL;
-    gint64 data_offset = 0;
     gchar err_msg[2048];
+    RawRecord record;
 
 	packet = Qnil;
 
 	do {
-		if (!wtap_read(cf.wth, &err, &err_info, &data_offset)) {
+		if (!reader.readNext(record, &err, &err_info)) {
 			if (err == 0) {
 				//Nothing wrong, just at the end of the file
 				return FALSE;
+			} else if (following && err == WTAP_ERR_SHORT_READ) {
+				//The writer is part-way through this record
+				if (err_info) {
+					::g_free(err_info);
+				}
+				return FALSE;
 			} else {
 				goto error;
 			}
-		} else if (err != 0) {
-			//Something amiss
-			goto error;
 		}
 		
+		/* Count this packet. */
+		cf.count++;
+		position.cumBytes += record.phdr->len;
+		position.lastRecordOffset = record.offset;
+
 		//processPacket will return Qnil if the packet doesn't match the filter rule
 		//associated with cf
-		packet = processPacket(capFileObject, cf, data_offset);		
+		packet = processPacket(capFileObject, cf, record, keepFrameData && !reader.isRecordDataStable(), static_cast<guint32>(cf.count), position.cumBytes);		
 	} while (NIL_P(packet));
 
     return TRUE;
@@ -219,39 +233,16 @@ void Packet::freePacket(VALUE packet) {
 	return nativePacket->free();
 }
 
+void Packet::snapshotPacketColumns(VALUE packet) {
+	Packet* nativePacket = NULL;
+	Data_Get_Struct(packet, Packet, nativePacket);
+	nativePacket->snapshotColumns();
+}
+
 #ifdef WINDOWS_BUILD
 #pragma warning(pop)
 #endif
 
-void Packet::getNodeSiblings(ProtocolTreeNode& node, NodeParentMap::iterator& lbound, NodeParentMap::iterator& ubound) {
-	guint64 parentPtr = 0;
-	if (node.getParentNode() != NULL) {
-		parentPtr = (guint64)node.getParentNode()->getProtoNode();
-	}
-
-	lbound = _nodesByParent.lower_bound(parentPtr);
-	ubound = _nodesByParent.upper_bound(parentPtr);
-}
-
-ProtocolTreeNode* Packet::getProtocolTreeNodeFromProtoNode(proto_node* node) {
-	//If the wrapper for this node is known to the packet, it will be in the list
-	//of ProtocolTreeNode objects who share node's parent.  Thus, like there
-	if (!node) { return NULL; }
-	NodeParentMap::iterator lbound, ubound;
-	lbound = _nodesByParent.lower_bound((guint64)node->parent);
-	ubound = _nodesByParent.upper_bound((guint64)node->parent);
-
-	for (NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
-		if (iter->second->getProtoNode() == node) {
-			return iter->second;
-		}
-	}
-
-	return NULL;
-}
-	
 const Blob* Packet::getBlobByDataSourcePtr(data_source* ds) {
 	ensureBlobsLoaded();
 
@@ -284,89 +275,161 @@ const Blob* Packet::getBlobByTvbuffPtr(tvbuff_t* tvb) {
 }
 
 void Packet::free() {
-	for (NodeNameMap::iterator iter = _nodesByName.begin();
-		iter != _nodesByName.end();
-		++iter) {
-		if (iter->second) {
-#ifdef USE_LOOKASIDE_LIST
-			_nodeLookaside->returnProtocolTreeNode(iter->second);
-#else
-			delete iter->second;
-#endif
-		}
-	}
+	//The nodes and the index storage all live in the arena, so rather than freeing them one
+	//by one, the index containers just drop their storage and the arena is reset
+	_nodes.clear();
 	_nodesByName.clear();
-	_nodesByParent.clear();
+	_arena.reset();
+	_nodesIndexed = FALSE;
+	_columnSnapshot.clear();
+	_columnsFilled = FALSE;
 
 	if (_edt) {
-		epan_dissect_free(_edt);
+		if (_dissectPool) {
+			_dissectPool->release(_edt);
+		} else {
+			epan_dissect_free(_edt);
+		}
 		_edt = NULL;
 	}
+
+	if (_dissectPool) {
+		_dissectPool->removeRef();
+		_dissectPool = NULL;
+	}
+
+	if (_frameDataCopy) {
+		::g_free(_frameDataCopy);
+		_frameDataCopy = NULL;
+	}
 	
 	clearFdata(&_frameData);
 }
 
-Packet::Packet() 
+Packet::Packet() :
+	_nodes(_arena),
+	_nodesByName(_arena)
 {
 	_edt = NULL;
+	_dissectPool = NULL;
 	_wth = NULL;
 	_cf = NULL;
+	_frameDataCopy = NULL;
 	_nodeCounter = 0;
+	_nodesIndexed = FALSE;
+	_columnsFilled = FALSE;
+	_interestedHfMask = NULL;
 	_blobsHash = Qnil;
+	_capFileObject = Qnil;
+	_nodeContext.packet = Qnil;
+	_nodeContext.edt = NULL;
+	_nodeContext.arena = &_arena;
 }
 
 Packet::~Packet(void) {
 	free();
 }
 	
-VALUE Packet::processPacket(VALUE capFileObject, capture_file& cf, gint64 offset) {
+VALUE Packet::dissectRecord(VALUE capFileObject, capture_file& cf, const RawRecord& record, guint32 frameNumber) {
+	//The cumulative byte count isn't known for frames read out of sequence
+	return processPacket(capFileObject, cf, record, TRUE, frameNumber, 0);
+}
+
+void Packet::primeDissectors(EpanDissectPool& pool, capture_file& cf, const RawRecord& record, guint32 frameNumber) {
+	frame_data fdata;
+	fillInFdata(&fdata, cf, record.phdr, record.offset, frameNumber, 0);
+
+	epan_dissect_t* edt = pool.acquire(FALSE, FALSE);
+	epan_dissect_run(edt, record.pseudoHeader, record.data, &fdata, NULL);
+	pool.release(edt);
+
+	clearFdata(&fdata);
+}
+
+VALUE Packet::processPacket(VALUE capFileObject, capture_file& cf, const RawRecord& record, gboolean copyFrameData, guint32 frameNumber, guint32 cumBytes) {
 	VALUE packet = Qnil;
+
+	//Frames the capture filter rejects still count, but skip dissection entirely
+	CapFile* capFile = NULL;
+	Data_Get_Struct(capFileObject, CapFile, capFile);
+	if (!capFile->passesCaptureFilter(record)) {
+		return packet;
+	}
 	
-	struct wtap_pkthdr *whdr = wtap_phdr(cf.wth);
-	union wtap_pseudo_header *pseudo_header = wtap_pseudoheader(cf.wth);
-	const guchar* pd = wtap_buf_ptr(cf.wth);
+	const struct wtap_pkthdr *whdr = record.phdr;
+	union wtap_pseudo_header *pseudo_header = record.pseudoHeader;
+	const guchar* pd = record.data;
+
+	//The dissectors reference the frame data in place, so if the packet has to outlive the
+	//reader's buffer, dissect a copy which the packet will own
+	guchar* frameDataCopy = NULL;
+	if (copyFrameData) {
+		frameDataCopy = reinterpret_cast<guchar*>(::g_memdup(pd, whdr->caplen));
+		pd = frameDataCopy;
+	}
 
     frame_data fdata;
     epan_dissect_t *edt;
     gboolean passed;
 
-    /* Count this packet. */
-    cf.count++;
-
     /* If we're going to print packet information, or we're going to
        run a read filter, or we're going to process taps, set up to
        do a dissection and do so. */
-    fillInFdata(&fdata, cf, whdr, offset);
+    fillInFdata(&fdata, cf, whdr, record.offset, frameNumber, cumBytes);
 
     passed = TRUE;
-    edt = epan_dissect_new(TRUE, TRUE);
 
-    /* If we're running a read filter, prime the epan_dissect_t with that
-       filter. */
-    if (cf.rfcode)
+    if (cf.rfcode && capFile->isFilterFirst()) {
+        /* Filter first: dissect with a tree holding only the fields the filter
+           references, and no columns, purely to decide whether the packet passes. */
+        edt = capFile->getDissectPool().acquire(TRUE, FALSE);
         epan_dissect_prime_dfilter(edt, cf.rfcode);
 
-    tap_queue_init(edt);
+        tap_queue_init(edt);
+        epan_dissect_run(edt, pseudo_header, pd, &fdata, NULL);
+        tap_push_tapped_queue(edt);
 
-    /* We only need the columns if we're printing packet info but we're
-       *not* verbose; in verbose mode, we print the protocol tree, not
-       the protocol summary. */
-    epan_dissect_run(edt, pseudo_header, pd, &fdata,
-//                     NULL);
-                     &cf.cinfo);
+        passed = dfilter_apply_edt(cf.rfcode, edt);
+        capFile->getDissectPool().release(edt);
+        edt = NULL;
+
+        if (passed) {
+            /* Now dissect it again in full for Ruby.  The dissectors have already
+               seen this frame, so mark it visited; that way they look up the state
+               they saved the first time rather than updating it all over again, just
+               as when Wireshark redissects a packet. */
+            fdata.flags.visited = 1;
+
+            edt = newFullDissection(*capFile);
+            epan_dissect_run(edt, pseudo_header, pd, &fdata, capFile->hasColumns() ? &cf.cinfo : NULL);
+        }
+    } else {
+        edt = newFullDissection(*capFile);
 
-    tap_push_tapped_queue(edt);
+        /* If we're running a read filter, prime the epan_dissect_t with that
+           filter. */
+        if (cf.rfcode)
+            epan_dissect_prime_dfilter(edt, cf.rfcode);
 
-    /* Run the read filter if we have one. */
-    if (cf.rfcode)
-        passed = dfilter_apply_edt(cf.rfcode, edt);
-    else
-        passed = TRUE;
+        tap_queue_init(edt);
+
+        /* We only need the columns if we're printing packet info but we're
+           *not* verbose; in verbose mode, we print the protocol tree, not
+           the protocol summary. */
+        epan_dissect_run(edt, pseudo_header, pd, &fdata,
+                         capFile->hasColumns() ? &cf.cinfo : NULL);
+
+        tap_push_tapped_queue(edt);
+
+        /* Run the read filter if we have one. */
+        if (cf.rfcode)
+            passed = dfilter_apply_edt(cf.rfcode, edt);
+        else
+            passed = TRUE;
+    }
 
     if (passed) {
-        if (edt->pi.cinfo) {
-            epan_dissect_fill_in_columns(edt);
-        }
+        /* The columns are filled in when they're first read; see ensureColumnsFilled */
         /* Passes the filter critera.  Create a Ruby Packet object and build it. */
 #ifndef SKIP_OBJECT_CREATION
 		VALUE argv[] = {
@@ -378,56 +441,63 @@ VALUE Packet::processPacket(VALUE capFileObject, capture_file& cf, gint64 offset
 											 argv,
 											 g_packet_class);
 
-		//Get the wrapped CapFile object
-		CapFile* capFile = NULL;
-		Data_Get_Struct(capFileObject, CapFile, capFile);
-
 		//Get the wrapped Packet object
 		Packet* nativePacket = NULL;
 		Data_Get_Struct(packet, Packet, nativePacket);
 
 		nativePacket->_frameData = fdata;
 		nativePacket->_edt = edt;
+		//The dissection points at the frame_data it was run with, which is about to go out of scope, and
+		//the columns are filled in from it long after this returns
+		nativePacket->_edt->pi.fd = &nativePacket->_frameData;
+		nativePacket->_dissectPool = &capFile->getDissectPool();
+		nativePacket->_dissectPool->addRef();
 		nativePacket->_wth = cf.wth;
 		nativePacket->_cf = &cf;
-#ifdef USE_LOOKASIDE_LIST
-		nativePacket->_nodeLookaside = &capFile->getNodeLookasideList();
-#endif
+		nativePacket->_frameDataCopy = frameDataCopy;
+		nativePacket->_interestedHfMask = capFile->getInterestedHfIds().empty() ? NULL : &capFile->getInterestedHfMask();
 
 		nativePacket->buildPacket();
 #else
 		capFileObject;
 		Packet* nativePacket = new Packet();
+		nativePacket->_frameData = fdata;
 		nativePacket->_edt = edt;
+		nativePacket->_edt->pi.fd = &nativePacket->_frameData;
+		nativePacket->_dissectPool = &capFile->getDissectPool();
+		nativePacket->_dissectPool->addRef();
 		nativePacket->_wth = cf.wth;
 		nativePacket->_cf = &cf;
+		nativePacket->_interestedHfMask = capFile->getInterestedHfIds().empty() ? NULL : &capFile->getInterestedHfMask();
 
 		nativePacket->buildPacket();
 		delete nativePacket;
+		::g_free(frameDataCopy);
 #endif
 
 	} else {
 		//Didn't pass filter, so free the packet info
-		epan_dissect_free(edt);
+		if (edt) {
+			capFile->getDissectPool().release(edt);
+		}
 		clearFdata(&fdata);
+		::g_free(frameDataCopy);
 	}
 
 	return packet;
 }
 
 
-void Packet::fillInFdata(frame_data *fdata, capture_file& cf,
-              const struct wtap_pkthdr *phdr, gint64 offset)
+void Packet::fillInFdata(frame_data *fdata, capture_file& ,
+              const struct wtap_pkthdr *phdr, gint64 offset, guint32 frameNumber, guint32 cumBytes)
 {
-  static guint32 cum_bytes = 0;
 
   fdata->next = NULL;
   fdata->prev = NULL;
   fdata->pfd = NULL;
-  fdata->num = cf.count;
+  fdata->num = frameNumber;
   fdata->pkt_len = phdr->len;
-  cum_bytes += phdr->len;
-  fdata->cum_bytes  = cum_bytes;
+  fdata->cum_bytes  = cumBytes;
   fdata->cap_len = phdr->caplen;
   fdata->file_off = offset;
   fdata->lnk_t = phdr->pkt_encap;
@@ -445,6 +515,22 @@ void Packet::fillInFdata(frame_data *fdata, capture_file& cf,
   fdata->del_cap_ts = fdata->abs_ts;
 }
 
+epan_dissect_t* Packet::newFullDissection(CapFile& capFile) {
+	const std::vector<int>& interestedHfIds = capFile.getInterestedHfIds();
+	if (interestedHfIds.empty()) {
+		return capFile.getDissectPool().acquire(TRUE, TRUE);
+	}
+
+	epan_dissect_t* edt = capFile.getDissectPool().acquire(TRUE, FALSE);
+	for (std::vector<int>::const_iterator iter = interestedHfIds.begin();
+		iter != interestedHfIds.end();
+		++iter) {
+		proto_tree_prime_hfid(edt->tree, *iter);
+	}
+
+	return edt;
+}
+
 void Packet::clearFdata(frame_data *fdata)
 {
 	if (fdata->pfd) {
@@ -483,6 +569,7 @@ VALUE Packet::initialize(VALUE self, VALUE capFileObject) {
 	Packet* packet = NULL;
 	Data_Get_Struct(self, Packet, packet);
 	packet->_self = self;
+	packet->_capFileObject = capFileObject;
 
     return self;
 }
@@ -627,6 +714,12 @@ VALUE Packet::each_descendant_field_match(VALUE self, VALUE parentField, VALUE q
 	return packet->eachDescendantFieldMatch(parentField, query);
 }
 	
+VALUE Packet::column(VALUE self, VALUE name) {
+	Packet* packet = NULL;
+	Data_Get_Struct(self, Packet, packet);
+	return packet->getColumnByName(name);
+}
+
 VALUE Packet::blobs(VALUE self) {
 	Packet* packet = NULL;
 	Data_Get_Struct(self, Packet, packet);
@@ -640,15 +733,32 @@ VALUE Packet::to_yaml(VALUE self) {
 }
 
 void Packet::buildPacket() {
+	//The node maps are built on demand by ensureNodesIndexed, so code that only reads the
+	//packet number or columns never pays for walking the tree
+	_nodesIndexed = FALSE;
+}
+
+void Packet::ensureNodesIndexed() {
+	if (_nodesIndexed || !_edt) {
+		return;
+	}
+	_nodesIndexed = TRUE;
+
 	//Add each of this packet's nodes to our node map
 	_nodeCounter = 0;
-	addProtocolNodes(_edt->tree);
+	_nodeContext.packet = _self;
+	_nodeContext.edt = _edt;
+	_nodeContext.arena = &_arena;
+	if (_interestedHfMask && !_interestedHfMask->empty()) {
+		addInterestedProtocolNodes(_edt->tree);
+	} else {
+		addProtocolNodes(_edt->tree);
+	}
 }
 
 void Packet::addNode(proto_node* node) {
-	//Add this node to the node map in two ways: by its header name,
-	//and by its parent's pointer value.  This allows access to fields by name
-	//and by parent field
+	//Add this node to the node table, which links it to its parent and siblings, and
+	//to the name index.  This allows access to fields by name and by parent field
 
 	//Find the ProtocolTreeNode object that wraps node->parent
 	ProtocolTreeNode* parentNode = NULL;
@@ -664,14 +774,11 @@ void Packet::addNode(proto_node* node) {
 		}
 	}
 
-#ifdef USE_LOOKASIDE_LIST
-	ProtocolTreeNode* nodeStruct = _nodeLookaside->getProtocolTreeNode(_self, _edt, _nodeCounter++, node, parentNode);
-#else
-	ProtocolTreeNode* nodeStruct = new ProtocolTreeNode(_self, _edt, _nodeCounter++, node, parentNode);
-#endif
+	//Arena nodes are never destroyed, only forgotten when the arena is reset
+	ProtocolTreeNode* nodeStruct = new(_arena.allocate(sizeof(ProtocolTreeNode))) ProtocolTreeNode(&_nodeContext, _nodeCounter++, node, parentNode);
 
-	_nodesByName.insert(NodeNameMap::value_type(nodeStruct->getName(), nodeStruct));
-	_nodesByParent.insert(NodeParentMap::value_type((guint64)node->parent, nodeStruct));
+	_nodes.add(nodeStruct);
+	_nodesByName.insert(nodeStruct);
 }
 	
 VALUE Packet::getRubyFieldObjectForField(ProtocolTreeNode& node) {
@@ -679,12 +786,17 @@ VALUE Packet::getRubyFieldObjectForField(ProtocolTreeNode& node) {
 }
 
 void Packet::mark() {
+	//The capture file has to stay around as long as its packets, which use its capture_file and wtap
+	if (!NIL_P(_capFileObject)) {
+		::rb_gc_mark(_capFileObject);
+	}
+
 	//Mark all the Ruby Field objects we know about
-	for (NodeNameMap::const_iterator iter = _nodesByName.begin();
-		iter != _nodesByName.end();
+	for (NodeTable::const_iterator iter = _nodes.begin();
+		iter != _nodes.end();
 		++iter) {
-		if (!NIL_P(iter->second->peekFieldObject())) {
-			::rb_gc_mark(iter->second->peekFieldObject());
+		if (!NIL_P((*iter)->peekFieldObject())) {
+			::rb_gc_mark((*iter)->peekFieldObject());
 		}
 	}
 
@@ -726,9 +838,11 @@ VALUE Packet::getInfo() {
 }
 
 VALUE Packet::fieldExists(VALUE fieldName) {
+	ensureNodesIndexed();
+
 	const gchar* name = RSTRING(::StringValue(fieldName))->ptr;
 
-	if (_nodesByName.find(name) == _nodesByName.end()) {
+	if (_nodesByName.findFirst(name) == NULL) {
 		return Qfalse;
 	} else {
 		return Qtrue;
@@ -736,6 +850,8 @@ VALUE Packet::fieldExists(VALUE fieldName) {
 }
 
 VALUE Packet::descendantFieldExists(VALUE parentField, VALUE fieldName) {
+	ensureNodesIndexed();
+
 	//Look for the given field name in the descendants of this field
 	if (NIL_P(parentField)) return Qfalse;
 
@@ -753,18 +869,22 @@ VALUE Packet::descendantFieldExists(VALUE parentField, VALUE fieldName) {
 }
 
 VALUE Packet::findFirstField(VALUE fieldName) {
+	ensureNodesIndexed();
+
 	const gchar* name = RSTRING(::StringValue(fieldName))->ptr;
 	if (!name) return Qnil;
 
-	NodeNameMap::iterator iter = _nodesByName.find(name);
-	if (iter == _nodesByName.end()) {
+	ProtocolTreeNode* node = _nodesByName.findFirst(name);
+	if (node == NULL) {
 		return Qnil;
 	}
 
-	return getRubyFieldObjectForField(*iter->second);
+	return getRubyFieldObjectForField(*node);
 }
 
 VALUE Packet::eachField(int argc, VALUE* argv) {
+	ensureNodesIndexed();
+
 	rb_need_block();
 
 	//each_field expects zero or one arguments
@@ -779,24 +899,28 @@ VALUE Packet::eachField(int argc, VALUE* argv) {
 		fieldName = RSTRING(fn)->ptr;
 	}
 
-	NodeNameMap::iterator lbound, ubound;
-
 	if (fieldName) {
-		//Limit the range to elements matching the range
-		lbound = _nodesByName.lower_bound(fieldName);
-		ubound = _nodesByName.upper_bound(fieldName);
+		//Just the fields with this name, which the index keeps in ordinal order
+		for (ProtocolTreeNode* node = _nodesByName.findFirst(fieldName);
+			node != NULL;
+			node = node->getNextWithSameName()) {
+			::rb_yield(getRubyFieldObjectForField(*node));
+		}
 	} else {
 		//Include all fields
-		lbound = _nodesByName.begin();
-		ubound = _nodesByName.end();
+		for (NodeTable::const_iterator iter = _nodes.begin();
+			iter != _nodes.end();
+			++iter) {
+			::rb_yield(getRubyFieldObjectForField(*(*iter)));
+		}
 	}
 
-	sortAndYield(lbound, ubound);
-
 	return _self;
 }
 
 VALUE Packet::findFirstDescendantField(VALUE parentField, VALUE fieldName) {
+	ensureNodesIndexed();
+
 	//Look for the given field name in the descendants of this field
 	if (NIL_P(parentField))  {
 		::rb_raise(::rb_eArgError, "parentField cannot be nil");
@@ -815,6 +939,8 @@ VALUE Packet::findFirstDescendantField(VALUE parentField, VALUE fieldName) {
 }
 
 VALUE Packet::eachDescendantField(int argc, VALUE* argv) {
+	ensureNodesIndexed();
+
 	rb_need_block();
 
 	//each_field expects 1 or two args
@@ -839,39 +965,35 @@ VALUE Packet::eachDescendantField(int argc, VALUE* argv) {
 		fieldName = RSTRING(fn)->ptr;
 	}
 
-	ProtocolTreeNodeOrderedSet sorted;
-	findDescendantFieldByName(parentFieldPtr->getProtoNode(), fieldName, sorted);
-
-	sortAndYield(sorted.begin(),
-		sorted.end());
+	//The descendants are a slice of the node table, already in ordinal order
+	yieldDescendantFieldsByName(parentFieldPtr->getProtoNode(), fieldName);
 
 	return _self;
 }
 	
 VALUE Packet::eachRootField() {
+	ensureNodesIndexed();
+
 	//Yield each field that has NULL as its parent
 	::rb_need_block();
 
-	NodeParentMap::iterator lbound, ubound;
-	lbound = _nodesByParent.lower_bound((guint64)_edt->tree);
-	ubound = _nodesByParent.upper_bound((guint64)_edt->tree);
-
-	for (NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
-		::rb_yield(iter->second->getFieldObject());
+	for (ProtocolTreeNode* node = _nodes.getFirstChild(NULL);
+		node != NULL;
+		node = _nodes.getNextSibling(node)) {
+		::rb_yield(node->getFieldObject());
 	}
 
 	return _self;
 }
 	
 VALUE Packet::fieldMatches(VALUE query) {
-	VALUE fieldQuery = FieldQuery::createFieldQuery(_self);
-	for (NodeNameMap::iterator iter = _nodesByName.begin();
-		iter != _nodesByName.end();
+	ensureNodesIndexed();
+
+	NodeQuery nodeQuery = prepareQuery(query);
+	for (NodeTable::const_iterator iter = _nodes.begin();
+		iter != _nodes.end();
 		++iter) {
-		FieldQuery::setFieldQueryCurrentNode(fieldQuery, iter->second);
-		if (FieldQuery::passFieldToProc(fieldQuery, query)) {
+		if (nodeMatches(*iter, nodeQuery)) {
 			//This field matched the query
 			return Qtrue;
 		}
@@ -882,16 +1004,18 @@ VALUE Packet::fieldMatches(VALUE query) {
 }
 
 VALUE Packet::descendantFieldMatches(VALUE parentField, VALUE query) {
+	ensureNodesIndexed();
+
 	//Look for the given field name in the descendants of this field
 	if (NIL_P(parentField))  {
 		::rb_raise(::rb_eArgError, "parentField cannot be nil");
 	}
 
-	VALUE fieldQuery = FieldQuery::createFieldQuery(_self);
+	NodeQuery nodeQuery = prepareQuery(query);
 
 	Field* field = NULL;
 	Data_Get_Struct(parentField, Field, field);
-	if (findDescendantNodeByQuery(field->getProtoNode(), fieldQuery, query)) {
+	if (findDescendantNodeByQuery(field->getProtoNode(), nodeQuery)) {
 		return Qtrue;
 	} else {
 		return Qfalse;
@@ -899,15 +1023,16 @@ VALUE Packet::descendantFieldMatches(VALUE parentField, VALUE query) {
 }
 
 VALUE Packet::findFirstFieldMatch(VALUE query) {
-	VALUE fieldQuery = FieldQuery::createFieldQuery(_self);
+	ensureNodesIndexed();
 
-	for (NodeNameMap::iterator iter = _nodesByName.begin();
-		iter != _nodesByName.end();
+	NodeQuery nodeQuery = prepareQuery(query);
+
+	for (NodeTable::const_iterator iter = _nodes.begin();
+		iter != _nodes.end();
 		++iter) {
-		FieldQuery::setFieldQueryCurrentNode(fieldQuery, iter->second);
-		if (FieldQuery::passFieldToProc(fieldQuery, query)) {
+		if (nodeMatches(*iter, nodeQuery)) {
 			//This field matched the query
-			return getRubyFieldObjectForField(*iter->second);
+			return getRubyFieldObjectForField(*(*iter));
 		}
 	}
 
@@ -916,29 +1041,27 @@ VALUE Packet::findFirstFieldMatch(VALUE query) {
 }
 
 VALUE Packet::eachFieldMatch(VALUE query) {
-	rb_need_block();
-	VALUE fieldQuery = FieldQuery::createFieldQuery(_self);
+	ensureNodesIndexed();
 
-	ProtocolTreeNodeOrderedSet sorted;
+	rb_need_block();
+	NodeQuery nodeQuery = prepareQuery(query);
 
-	for (NodeNameMap::iterator iter = _nodesByName.begin();
-		iter != _nodesByName.end();
+	//Nodes are kept in ordinal order, so each match can be yielded as soon as it's found
+	for (NodeTable::const_iterator iter = _nodes.begin();
+		iter != _nodes.end();
 		++iter) {
-		FieldQuery::setFieldQueryCurrentNode(fieldQuery, iter->second);
-		if (FieldQuery::passFieldToProc(fieldQuery, query)) {
+		if (nodeMatches(*iter, nodeQuery)) {
 			//This field matched the query
-			sorted.insert(iter->second);
+			::rb_yield(getRubyFieldObjectForField(*(*iter)));
 		}
 	}
 
-	//Yield all of the matches
-	sortAndYield(sorted.begin(),
-		sorted.end());
-
 	return _self;
 }
 
 VALUE Packet::findFirstDescendantFieldMatch(VALUE parentField, VALUE query) {
+	ensureNodesIndexed();
+
 	//Look for the given field name in the descendants of this field
 	if (NIL_P(parentField))  {
 		::rb_raise(::rb_eArgError, "parentField cannot be nil");
@@ -946,13 +1069,14 @@ VALUE Packet::findFirstDescendantFieldMatch(VALUE parentField, VALUE query) {
 
 	Field* field = NULL;
 	Data_Get_Struct(parentField, Field, field);
-	VALUE fieldQuery = FieldQuery::createFieldQuery(_self);
+	NodeQuery nodeQuery = prepareQuery(query);
 	return findDescendantFieldByQuery(field->getProtoNode(),
-		fieldQuery,
-		query);
+		nodeQuery);
 }
 
 VALUE Packet::eachDescendantFieldMatch(VALUE parentField, VALUE query) {
+	ensureNodesIndexed();
+
 	if (NIL_P(parentField))  {
 		::rb_raise(::rb_eArgError, "parentField cannot be nil");
 	}
@@ -961,17 +1085,10 @@ VALUE Packet::eachDescendantFieldMatch(VALUE parentField, VALUE query) {
 
 	Field* parentFieldPtr = NULL;
 	Data_Get_Struct(parentField, Field, parentFieldPtr);
-	VALUE fieldQuery = FieldQuery::createFieldQuery(_self);
-
-	ProtocolTreeNodeOrderedSet sorted;
+	NodeQuery nodeQuery = prepareQuery(query);
 
-	findDescendantFieldByQuery(parentFieldPtr->getProtoNode(),
-		fieldQuery,
-		query,
-		sorted);
-
-	sortAndYield(sorted.begin(),
-		sorted.end());
+	yieldDescendantFieldsByQuery(parentFieldPtr->getProtoNode(),
+		nodeQuery);
 
 	return _self;
 }
@@ -985,6 +1102,8 @@ VALUE Packet::getBlobs() {
 }
 
 VALUE Packet::toYaml() {
+	ensureNodesIndexed();
+
     YamlGenerator yaml;
 
     //The YAML representation is a nested sequence of fields.  Each field is represented as a 
@@ -993,14 +1112,10 @@ VALUE Packet::toYaml() {
     yaml.startList();
 
     //Start with the root fields and go from there
-	NodeParentMap::iterator lbound, ubound;
-	lbound = _nodesByParent.lower_bound((guint64)_edt->tree);
-	ubound = _nodesByParent.upper_bound((guint64)_edt->tree);
-
-	for (NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
-        addFieldToYaml(iter->second, yaml);
+	for (ProtocolTreeNode* node = _nodes.getFirstChild(NULL);
+		node != NULL;
+		node = _nodes.getNextSibling(node)) {
+        addFieldToYaml(node, yaml);
 	}
 
     yaml.endList();
@@ -1008,10 +1123,43 @@ VALUE Packet::toYaml() {
     return ::rb_str_new2(yaml.getStringBuffer().str().c_str());
 }
 
+void Packet::ensureColumnsFilled() {
+    //Converting the columns to text is only done for packets whose columns are actually read.  The
+    //dissectors still format COL_INFO and the like as they run, whenever there are columns at all; only
+    //columns = [] avoids that.  The column buffers are shared by the capture file, so this must happen
+    //before the next packet is dissected; snapshotColumns takes care of that for batches and packet_at.
+    //It reads the frame number and timestamps through pi.fd, which processPacket points at _frameData
+    if (_columnsFilled || !_edt || !_edt->pi.cinfo) { return; }
+
+    epan_dissect_fill_in_columns(_edt);
+    _columnsFilled = TRUE;
+}
+
 VALUE Packet::getColumn(gint colFormat) {
-    if (!_edt->pi.cinfo) { return Qnil; }
+    if (!_edt || !_edt->pi.cinfo) { return Qnil; }
+    ensureColumnsFilled();
     for (gint idx = 0; idx < _edt->pi.cinfo->num_cols; idx++) {
         if (_edt->pi.cinfo->col_fmt[idx] == colFormat) {
+            if (!_columnSnapshot.empty()) {
+                return rb_str_new(_columnSnapshot[idx].c_str(), static_cast<long>(_columnSnapshot[idx].length()));
+            }
+            return rb_str_new2(_edt->pi.cinfo->col_data[idx]);
+        }
+    }
+
+    return Qnil;
+}
+
+VALUE Packet::getCustomColumn(const gchar* fieldName) {
+    if (!_edt || !_edt->pi.cinfo) { return Qnil; }
+    ensureColumnsFilled();
+
+    for (gint idx = 0; idx < _edt->pi.cinfo->num_cols; idx++) {
+        if (_edt->pi.cinfo->col_fmt[idx] == COL_CUSTOM && 
+            ::strcmp(_edt->pi.cinfo->col_custom_field[idx], fieldName) == 0) {
+            if (!_columnSnapshot.empty()) {
+                return rb_str_new(_columnSnapshot[idx].c_str(), static_cast<long>(_columnSnapshot[idx].length()));
+            }
             return rb_str_new2(_edt->pi.cinfo->col_data[idx]);
         }
     }
@@ -1019,6 +1167,32 @@ VALUE Packet::getColumn(gint colFormat) {
     return Qnil;
 }
 
+VALUE Packet::getColumnByName(VALUE name) {
+    if (SYMBOL_P(name)) {
+        const char* columnName = ::rb_id2name(SYM2ID(name));
+        gint format = CapFile::columnFormatFromName(columnName);
+        if (format < 0) {
+            ::rb_raise(::rb_eArgError, "'%s' is not a known column", columnName);
+        }
+
+        return getColumn(format);
+    }
+
+    return getCustomColumn(RSTRING(::StringValue(name))->ptr);
+}
+
+void Packet::snapshotColumns() {
+    _columnSnapshot.clear();
+    if (!_edt || !_edt->pi.cinfo) { return; }
+    ensureColumnsFilled();
+
+    _columnSnapshot.reserve(_edt->pi.cinfo->num_cols);
+    for (gint idx = 0; idx < _edt->pi.cinfo->num_cols; idx++) {
+        const gchar* data = _edt->pi.cinfo->col_data[idx];
+        _columnSnapshot.push_back(data ? data : "");
+    }
+}
+
 void Packet::addFieldToYaml(ProtocolTreeNode* node, YamlGenerator& yaml) {
     const char* fieldName = NULL;
     char fieldOrdinalBuffer[20];
@@ -1057,13 +1231,13 @@ void Packet::addFieldToYaml(ProtocolTreeNode* node, YamlGenerator& yaml) {
         }
 
         //Add children, if any
-        if (node->getProtoNode()->first_child) {
+        ProtocolTreeNode* child = _nodes.getFirstChild(node);
+        if (child) {
             yaml.startMappingToList("children");
 
-            ProtocolTreeNode* child = getProtocolTreeNodeFromProtoNode(node->getProtoNode()->first_child);
             while (child) {
                 addFieldToYaml(child, yaml);
-                child = getProtocolTreeNodeFromProtoNode(child->getProtoNode()->next);
+                child = _nodes.getNextSibling(child);
             }
 
             yaml.endMapping();
@@ -1096,6 +1270,31 @@ void Packet::addProtocolNodes(proto_tree *tree) {
 	}
 }
 
+void Packet::addInterestedProtocolNodes(proto_tree *tree) {
+	for (proto_node* current = tree->first_child;
+		current != NULL;
+		current = current->next) {
+		int hfId = current->finfo->hfinfo->id;
+		if (hfId >= 0 && 
+			static_cast<size_t>(hfId) < _interestedHfMask->size() && 
+			(*_interestedHfMask)[hfId]) {
+			addNodeWithAncestors(current);
+		}
+
+		addInterestedProtocolNodes((proto_tree *)current);
+	}
+}
+
+void Packet::addNodeWithAncestors(proto_node* node) {
+	//The tree is walked in order, so any ancestor not added by now isn't interesting in itself, and
+	//adding it here, just ahead of its first interesting descendant, keeps the ordinals in tree order
+	if (node->parent != _edt->tree && getProtocolTreeNodeFromProtoNode(node->parent) == NULL) {
+		addNodeWithAncestors(node->parent);
+	}
+
+	addNode(node);
+}
+
 void Packet::ensureBlobsLoaded() {
 	if (NIL_P(_blobsHash)) {
 		addDataSourcesAsBlobs(_edt->pi.data_src);
@@ -1128,22 +1327,45 @@ void Packet::addDataSourceAsBlob(data_source* ds) {
 	_blobs.push_back(blob);
 }
 
+Packet::NodeQuery Packet::prepareQuery(VALUE query) {
+	NodeQuery nodeQuery;
+	nodeQuery.compiled = CompiledFieldQuery::fromRubyObject(query);
+	nodeQuery.proc = Qnil;
+	nodeQuery.fieldQuery = Qnil;
+
+	if (!nodeQuery.compiled) {
+		//Coerce the query to a Proc once, here, rather than for every node it's called with
+		nodeQuery.proc = FieldQuery::ensureIsProc(query);
+		nodeQuery.fieldQuery = FieldQuery::createFieldQuery(_self);
+	}
+
+	return nodeQuery;
+}
+
+bool Packet::nodeMatches(ProtocolTreeNode* node, NodeQuery& query) {
+	if (query.compiled) {
+		return query.compiled->matches(*this, *node);
+	}
+
+	FieldQuery::setFieldQueryCurrentNode(query.fieldQuery, node);
+	return FieldQuery::passFieldToProc(query.fieldQuery, query.proc);
+}
+
 ProtocolTreeNode* Packet::findDescendantNodeByName(ProtocolTreeNode* parent, const gchar* name) {
-	NodeParentMap::iterator lbound = _nodesByParent.lower_bound((guint64)parent->getProtoNode());
-	NodeParentMap::iterator ubound = _nodesByParent.upper_bound((guint64)parent->getProtoNode());
-	for (NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
-		if (name == NULL ||
-			::strcmp(name, iter->second->getName()) == 0) {
-			//Found it
-			return iter->second;
-		}
+	//The descendants are the slice of the node table from just after the parent to its subtree end
+	guint end = _nodes.getSubtreeEnd(parent);
 
-		//Else, search children
-		ProtocolTreeNode* match = findDescendantNodeByName(iter->second, name);
-		if (match) {
-			return match;
+	if (name == NULL) {
+		return parent->getOrdinal() + 1 < end ? _nodes.at(parent->getOrdinal() + 1) : NULL;
+	}
+
+	//The name index keeps each name's nodes in ordinal order, so walk it up to the end of the slice
+	for (ProtocolTreeNode* node = _nodesByName.findFirst(name);
+		node != NULL && node->getOrdinal() < end;
+		node = node->getNextWithSameName()) {
+		if (node->getOrdinal() > parent->getOrdinal()) {
+			//Found it
+			return node;
 		}
 	}
 
@@ -1160,47 +1382,39 @@ VALUE Packet::findDescendantFieldByName(ProtocolTreeNode* parent, const gchar* n
 	return Qnil;
 }
 
-void Packet::findDescendantFieldByName(ProtocolTreeNode* parent, const gchar* name, ProtocolTreeNodeOrderedSet& set) {
-	NodeParentMap::iterator lbound = _nodesByParent.lower_bound((guint64)parent->getProtoNode());
-	NodeParentMap::iterator ubound = _nodesByParent.upper_bound((guint64)parent->getProtoNode());
-	for (NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
-		if (name == NULL ||
-			::strcmp(name, iter->second->getName()) == 0) {
-			//Found it
-			set.insert(iter->second);
+void Packet::yieldDescendantFieldsByName(ProtocolTreeNode* parent, const gchar* name) {
+	guint end = _nodes.getSubtreeEnd(parent);
+
+	if (name == NULL) {
+		for (guint ordinal = parent->getOrdinal() + 1; ordinal < end; ordinal++) {
+			::rb_yield(getRubyFieldObjectForField(*_nodes.at(ordinal)));
 		}
+		return;
+	}
 
-		//Search children
-		findDescendantFieldByName(iter->second, name, set);
+	for (ProtocolTreeNode* node = findDescendantNodeByName(parent, name);
+		node != NULL && node->getOrdinal() < end;
+		node = node->getNextWithSameName()) {
+		::rb_yield(getRubyFieldObjectForField(*node));
 	}
 }
 
-ProtocolTreeNode* Packet::findDescendantNodeByQuery(ProtocolTreeNode* parent, VALUE fieldQueryObject, VALUE query) {
-	NodeParentMap::iterator lbound = _nodesByParent.lower_bound((guint64)parent->getProtoNode());
-	NodeParentMap::iterator ubound = _nodesByParent.upper_bound((guint64)parent->getProtoNode());
-	for (NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
-		FieldQuery::setFieldQueryCurrentNode(fieldQueryObject, iter->second);
-		if (FieldQuery::passFieldToProc(fieldQueryObject, query)) {
-			//Found it
-			return iter->second;
-		}
+ProtocolTreeNode* Packet::findDescendantNodeByQuery(ProtocolTreeNode* parent, NodeQuery& query) {
+	guint end = _nodes.getSubtreeEnd(parent);
 
-		//Else, search children
-		ProtocolTreeNode* match = findDescendantNodeByQuery(iter->second, fieldQueryObject, query);
-		if (match) {
-			return match;
+	for (guint ordinal = parent->getOrdinal() + 1; ordinal < end; ordinal++) {
+		ProtocolTreeNode* node = _nodes.at(ordinal);
+		if (nodeMatches(node, query)) {
+			//Found it
+			return node;
 		}
 	}
 
 	return NULL;
 }
 
-VALUE Packet::findDescendantFieldByQuery(ProtocolTreeNode* parent, VALUE fieldQueryObject, VALUE query) {
-	ProtocolTreeNode* match = findDescendantNodeByQuery(parent, fieldQueryObject, query);
+VALUE Packet::findDescendantFieldByQuery(ProtocolTreeNode* parent, NodeQuery& query) {
+	ProtocolTreeNode* match = findDescendantNodeByQuery(parent, query);
 	if (match) {
 		return getRubyFieldObjectForField(*match);
 	}
@@ -1208,19 +1422,13 @@ VALUE Packet::findDescendantFieldByQuery(ProtocolTreeNode* parent, VALUE fieldQu
 	return Qnil;
 }
 
-void Packet::findDescendantFieldByQuery(ProtocolTreeNode* parent, VALUE fieldQueryObject, VALUE query, ProtocolTreeNodeOrderedSet& set) {
-	NodeParentMap::iterator lbound = _nodesByParent.lower_bound((guint64)parent->getProtoNode());
-	NodeParentMap::iterator ubound = _nodesByParent.upper_bound((guint64)parent->getProtoNode());
-	for (NodeParentMap::iterator iter = lbound;
-		iter != ubound;
-		++iter) {
-		FieldQuery::setFieldQueryCurrentNode(fieldQueryObject, iter->second);
-		if (FieldQuery::passFieldToProc(fieldQueryObject, query)) {
-			//Found it
-			set.insert(iter->second);
-		}
+void Packet::yieldDescendantFieldsByQuery(ProtocolTreeNode* parent, NodeQuery& query) {
+	guint end = _nodes.getSubtreeEnd(parent);
 
-		//Search children
-		findDescendantFieldByQuery(iter->second, fieldQueryObject, query, set);
+	for (guint ordinal = parent->getOrdinal() + 1; ordinal < end; ordinal++) {
+		ProtocolTreeNode* node = _nodes.at(ordinal);
+		if (nodeMatches(node, query)) {
+			::rb_yield(getRubyFieldObjectForField(*node));
+		}
 	}
 }
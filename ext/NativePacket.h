@@ -1,19 +1,23 @@
 #pragma once
 
-#include <map>
+#include <list>
 #include <string>
-#include <set>
+#include <vector>
 
 #include "RubyAndShit.h"
 
 #include "rcapdissector.h"
+#include "RecordReader.h"
 
 #include "ProtocolTreeNode.h"
+#include "EpanDissectPool.h"
+#include "NodeNameIndex.h"
+#include "NodeTable.h"
+#include "PacketArena.h"
+
+class CapFile;
+class CompiledFieldQuery;
 
-#ifdef USE_LOOKASIDE_LIST
-#include "RubyAllocator.h"
-#include "ProtocolTreeNodeLookasideList.h"
-#endif
 #include "YamlGenerator.h"
 #include "Blob.h"
 
@@ -32,27 +36,48 @@
 class Packet
 {
 public:
-	/** Contains fields keyed by their name */
-	typedef std::multimap<std::string, ProtocolTreeNode*> NodeNameMap;
+	static VALUE createClass();
 
-	/** Contains nodes keyed by their parent node's memory address */
-	typedef std::multimap<guint64, ProtocolTreeNode*> NodeParentMap;
+	/** Gets the next packet from a capfile object's record reader, returning false if the end of the capfile is reached.
+	'position' is advanced past every record read, whether or not it passes the filter.
+	If keepFrameData is true, the packet's frame data remains valid after the next packet is read.
+	If following is true, a record cut short at the end of the file is treated as the end of the file, since
+	the rest of it may yet be written */
+	static gboolean getNextPacket(VALUE capFileObject, capture_file& cf, RecordReader& reader, ReadPosition& position, VALUE& packet, gboolean keepFrameData = FALSE, gboolean following = FALSE);
 
-	static VALUE createClass();
+	/** Dissects a single record read out of sequence, such as via the frame index, giving it the specified
+	frame number.  Returns Qnil if the packet doesn't pass the display filter.  The packet gets its own copy
+	of the frame data, so the record's buffer can be reused as soon as this returns */
+	static VALUE dissectRecord(VALUE capFileObject, capture_file& cf, const RawRecord& record, guint32 frameNumber);
 
-	/** Gets the next packet from a capfile object, returning false if the end of the capfile is reached */
-	static gboolean getNextPacket(VALUE capFileObject, capture_file& cf, VALUE& packet);
+	/** Dissects a record without building a protocol tree, columns, or a Ruby object, purely so the dissectors
+	see the frame and update their conversation and reassembly state.  The context comes from, and goes back to,
+	the capture file's pool */
+	static void primeDissectors(EpanDissectPool& pool, capture_file& cf, const RawRecord& record, guint32 frameNumber);
 
 	/** Frees the native resources associated with a Ruby Packet object */
 	static void freePacket(VALUE packet);
 
+	/** Copies the column values of a Ruby Packet object out of the capture file's shared column
+	buffers, so the packet's columns remain valid after subsequent packets are dissected */
+	static void snapshotPacketColumns(VALUE packet);
+
 	epan_dissect_t* getEpanDissect() { return _edt; }
 
-	/** Gets the range of nodes, including the given node and any siblings nodes, which share the same parent node */
-	void getNodeSiblings(ProtocolTreeNode& node, NodeParentMap::iterator& lbound, NodeParentMap::iterator& ubound);
+	/** Gets the first of the nodes which share the given node's parent node; that may be the given node itself */
+	ProtocolTreeNode* getFirstSibling(const ProtocolTreeNode& node) { return _nodes.getFirstChild(node.getParentNode()); }
+
+	/** Gets the node following the given node under the same parent, or NULL if it's the last */
+	ProtocolTreeNode* getNextSibling(const ProtocolTreeNode& node) { return _nodes.getNextSibling(&node); }
+
+	/** Gets a node's first child, or NULL if it hasn't any */
+	ProtocolTreeNode* getFirstChild(const ProtocolTreeNode& node) { return _nodes.getFirstChild(&node); }
+
+	/** True if 'node' is somewhere beneath 'ancestor' in the protocol tree */
+	gboolean isDescendant(const ProtocolTreeNode& node, const ProtocolTreeNode& ancestor) { return _nodes.isDescendant(&node, &ancestor); }
 
 	/** Finds the ProtocolTreeNode wrapper for a given proto_node */
-	ProtocolTreeNode* getProtocolTreeNodeFromProtoNode(proto_node* node);
+	ProtocolTreeNode* getProtocolTreeNodeFromProtoNode(proto_node* node) { return _nodes.find(node); }
 
 	/** Find the Blob object that wraps the given data_source pointer, or NULL if not found */
 	const Blob* getBlobByDataSourcePtr(data_source* ds);
@@ -60,29 +85,24 @@ public:
 	/** Find the Blob object that wraps the data_source which contains the given tvb */
 	const Blob* getBlobByTvbuffPtr(tvbuff_t* tvb);
 
-	/** Releases the protocol tree nodes allocated for this packet.  Needs to happen before
-	CapFile is GC'd if using lookaside list*/
+	/** Releases the protocol tree nodes allocated for this packet, and the dissection context behind them.
+	The context goes back to its pool, which this packet holds a reference to, so it's safe even once the
+	CapFile has been GC'd */
 	void free();
 
 private:
-	/** A version of the less<> comparator that operates on ProtocolTreeNode pointers, using the ordinal to sort */
-	class ProtocolTreeNodeLess {
-	public:
-		typedef ProtocolTreeNode* first_argument_type;
-		typedef ProtocolTreeNode* second_argument_type;
-		typedef bool result_type;
-
-		ProtocolTreeNodeLess() 
-		{}
-
-		bool operator()(ProtocolTreeNode const* lhs, ProtocolTreeNode const* rhs) {
-			return lhs->getOrdinal() < rhs->getOrdinal();
-		}
-	};
+	typedef std::list<Blob*> BlobsList;
 
-	typedef std::set<ProtocolTreeNode*, ProtocolTreeNodeLess> ProtocolTreeNodeOrderedSet;
+	/** A query given to one of the field matching methods: either a CompiledFieldQuery, evaluated natively,
+	or a Proc, called with a FieldQuery object positioned on each node in turn */
+	struct NodeQuery {
+		CompiledFieldQuery* compiled;
+		VALUE proc;
+		VALUE fieldQuery;
+	};
 
-	typedef std::list<Blob*> BlobsList;
+	/** Column values copied from the shared column buffers, in column index order */
+	typedef std::vector<std::string> ColumnValues;
 
 	Packet();
 	virtual ~Packet(void);
@@ -94,13 +114,17 @@ private:
 
 	/** Applies whatever filter is outstanding, and if packet passes filter, creates a Ruby Packet object 
 	and its corresponding native object */
-	static VALUE processPacket(VALUE capFileObject, capture_file& cf, gint64 offset);
+	static VALUE processPacket(VALUE capFileObject, capture_file& cf, const RawRecord& record, gboolean copyFrameData, guint32 frameNumber, guint32 cumBytes);
 
 	/*@ Packet capture helper methods */
 	static void fillInFdata(frame_data *fdata, capture_file& cf,
-				  const struct wtap_pkthdr *phdr, gint64 offset);
+				  const struct wtap_pkthdr *phdr, gint64 offset, guint32 frameNumber, guint32 cumBytes);
 	static void clearFdata(frame_data *fdata);
 
+	/** Creates the epan_dissect_t for a full dissection.  If the capture file has interested fields, the tree
+	is made invisible and primed with just those fields, so epan fakes every other field rather than building it */
+	static epan_dissect_t* newFullDissection(CapFile& capFile);
+
 	/*@ Methods implementing the Packet Ruby object methods */
 	static void free(void* p);
 	static void mark(void* p);
@@ -114,6 +138,7 @@ private:
         static VALUE destination_address(VALUE self);
         static VALUE protocol(VALUE self);
         static VALUE info(VALUE self);
+        static VALUE column(VALUE self, VALUE name);
 	static VALUE field_exists(VALUE self, VALUE fieldName);
 	static VALUE descendant_field_exists(VALUE self, VALUE parentField, VALUE fieldName);
 	static VALUE find_first_field(VALUE self, VALUE fieldName);
@@ -135,6 +160,9 @@ private:
 
 	/*@ Instance methods that actually perform the Packet-specific work */
 	void buildPacket();
+
+	/** Builds the node table and name index, the first time they're needed */
+	void ensureNodesIndexed();
 	void addNode(proto_node* node);
 	VALUE getRubyFieldObjectForField(ProtocolTreeNode& node);
 	void mark();
@@ -165,11 +193,29 @@ private:
 
     VALUE getColumn(gint colFormat);
 
+    /** Gets the value of the custom column showing the named field */
+    VALUE getCustomColumn(const gchar* fieldName);
+
+    /** Gets a column by the Symbol naming a built-in column, or the String naming a custom column's field */
+    VALUE getColumnByName(VALUE name);
+
+    /** Fills in the packet's columns, the first time they're read */
+    void ensureColumnsFilled();
+
+	void snapshotColumns();
+
     void addFieldToYaml(ProtocolTreeNode* node, YamlGenerator& yaml);
 
 	/** Recursive function that adds nodes in a protocol tree to the node list */
 	void addProtocolNodes(proto_tree *tree);
 
+	/** Recursive function that adds only the interested fields in a protocol tree, and the nodes above them, to the
+	node list */
+	void addInterestedProtocolNodes(proto_tree *tree);
+
+	/** Adds a node to the node list, first adding any of its ancestors which aren't already there */
+	void addNodeWithAncestors(proto_node* node);
+
 	void ensureBlobsLoaded();
 
 	/** Adds the data_source's for the packet as Blobs */
@@ -177,68 +223,65 @@ private:
 
 	void addDataSourceAsBlob(data_source* ds);
 
-	/** Recursive function that searches a branch of the protocol tree for a field of a given name */
+	/** Finds the first field beneath a node with a given name, or the first field beneath it at all if name is NULL */
 	ProtocolTreeNode* findDescendantNodeByName(ProtocolTreeNode* parent, const gchar* name);
 
-	/** Recursive function that searches a branch of the protocol tree for a field of a given name */
+	/** Finds the first field beneath a node with a given name, returning its Ruby Field object or Qnil */
 	VALUE findDescendantFieldByName(ProtocolTreeNode* parent, const gchar* name);
 
-	/** Recursive function that searches a branch of the protocol tree and adds every field that matches to the set */
-	void findDescendantFieldByName(ProtocolTreeNode* parent, const gchar* name, ProtocolTreeNodeOrderedSet& set);
-
-	/** Recursive function that searches a branch of the protocol tree for a field matching a given query */
-	ProtocolTreeNode* findDescendantNodeByQuery(ProtocolTreeNode* parent, VALUE fieldQueryObject, VALUE query);
+	/** Yields every field beneath a node with a given name, or every field beneath it if name is NULL, in ordinal order */
+	void yieldDescendantFieldsByName(ProtocolTreeNode* parent, const gchar* name);
 
-	/** Recursive function that searches a branch of the protocol tree for a field matching a given query */
-	VALUE findDescendantFieldByQuery(ProtocolTreeNode* parent, VALUE fieldQueryObject, VALUE query);
+	/** Sets up a query passed to one of the field matching methods for evaluation against this packet's nodes */
+	NodeQuery prepareQuery(VALUE query);
 
-	/** Recursive function that searches a branch of the protocol tree and adds every field that matches to the set */
-	void findDescendantFieldByQuery(ProtocolTreeNode* parent, VALUE fieldQueryObject, VALUE query, ProtocolTreeNodeOrderedSet& set);
+	/** Evaluates a query against a node, natively if it's compiled, or else by calling the query proc */
+	bool nodeMatches(ProtocolTreeNode* node, NodeQuery& query);
 
-	/** Sorts a range of ProtocolTreeNode* objects identified by iterators of Pair<>s, then calls rb_yield
-	with the Field object for each node */
-	template <typename T>
-	void sortAndYield(T begin, T end) {
-		ProtocolTreeNodeOrderedSet sorted;
-		fillSetWithRange(begin, end, sorted);
+	/** Finds the first field beneath a node matching a given query */
+	ProtocolTreeNode* findDescendantNodeByQuery(ProtocolTreeNode* parent, NodeQuery& query);
 
-		for (ProtocolTreeNodeOrderedSet::iterator iter = sorted.begin();
-			iter != sorted.end();
-			++iter) {
-			::rb_yield(getRubyFieldObjectForField(*(*iter)));
-		}
-	}
-
-	/** Specialization of sortAndYield for ProtocolTreeNodeOrderedSet iterators */
-	void sortAndYield(ProtocolTreeNodeOrderedSet::iterator begin, ProtocolTreeNodeOrderedSet::iterator end) {
-		for (ProtocolTreeNodeOrderedSet::iterator iter = begin;
-			iter != end;
-			++iter) {
-			::rb_yield(getRubyFieldObjectForField(*(*iter)));
-		}
-	}
+	/** Finds the first field beneath a node matching a given query, returning its Ruby Field object or Qnil */
+	VALUE findDescendantFieldByQuery(ProtocolTreeNode* parent, NodeQuery& query);
 
-	/** Fills a ProtocolTreeNodeORderedSet with the ProtocolTreeNode objects from a range of iterators */
-	template<typename T>
-	void fillSetWithRange(T begin, T end, ProtocolTreeNodeOrderedSet& sorted) {
-		while (begin != end) {
-			sorted.insert(begin->second);
-			++begin;
-		}
-	}
+	/** Yields every field beneath a node matching a given query, in ordinal order */
+	void yieldDescendantFieldsByQuery(ProtocolTreeNode* parent, NodeQuery& query);
 
 	VALUE _self;
 	epan_dissect_t* _edt;
+
+	/** The pool _edt came from, and goes back to when the packet is freed; the packet holds a reference to it */
+	EpanDissectPool* _dissectPool;
+
+	/** The Ruby CapFile this packet came from; marked, so it lives at least as long as the packet does */
+	VALUE _capFileObject;
 	frame_data _frameData;
 	wtap* _wth;
 	capture_file* _cf;
-	NodeNameMap _nodesByName;
-	NodeParentMap _nodesByParent;
+
+	/** Where the nodes, and the node table and name index storage, are allocated; declared ahead of them
+	so it's constructed first */
+	PacketArena _arena;
+	NodeTable _nodes;
+	NodeNameIndex _nodesByName;
+
+	/** Shared by all of this packet's nodes */
+	ProtocolTreeNodeContext _nodeContext;
 	VALUE _blobsHash;
 	BlobsList _blobs;
+	ColumnValues _columnSnapshot;
+
+	/** This packet's own copy of its frame data, if the reader's buffer couldn't be relied upon to outlive the packet */
+	guchar* _frameDataCopy;
 
 	guint _nodeCounter;
-#ifdef USE_LOOKASIDE_LIST
-	ProtocolTreeNodeLookasideList* _nodeLookaside;
-#endif
+
+	/** True once the columns have been formatted; see ensureColumnsFilled */
+	gboolean _columnsFilled;
+
+	/** True once the node maps have been built; see ensureNodesIndexed */
+	gboolean _nodesIndexed;
+
+	/** The capture file's interested fields, indexed by header field id, or NULL if every field is wrapped */
+	const std::vector<bool>* _interestedHfMask;
 };
@@ -0,0 +1,120 @@
+#include "NodeNameIndex.h"
+#include "ProtocolTreeNode.h"
+
+/** The number of slots a fresh index starts out with; must be a power of two */
+#define INITIAL_NODE_NAME_SLOTS                 64
+
+std::vector<guint32> NodeNameIndex::s_hashesByHfId;
+
+NodeNameIndex::NodeNameIndex(PacketArena& arena) :
+	_slots(ArenaAllocator<Slot>(arena))
+{
+	_used = 0;
+}
+
+NodeNameIndex::~NodeNameIndex(void)
+{
+}
+
+void NodeNameIndex::insert(ProtocolTreeNode* node) {
+	//Keep the load factor at or below one half, so probe sequences stay short
+	if (_slots.empty()) {
+		Slot empty = { NULL, 0, NULL, NULL };
+		_slots.assign(INITIAL_NODE_NAME_SLOTS, empty);
+	} else if ((_used + 1) * 2 > _slots.size()) {
+		grow();
+	}
+
+	const gchar* name = node->getName();
+	guint32 hash = hashNode(node);
+
+	Slot& slot = _slots[findSlot(name, hash)];
+	if (!slot.name) {
+		slot.name = name;
+		slot.hash = hash;
+		slot.first = node;
+		_used++;
+	} else {
+		slot.last->setNextWithSameName(node);
+	}
+	slot.last = node;
+}
+
+ProtocolTreeNode* NodeNameIndex::findFirst(const gchar* name) const {
+	if (!name || _used == 0) {
+		return NULL;
+	}
+
+	const Slot& slot = _slots[findSlot(name, hashName(name))];
+	return slot.first;
+}
+
+void NodeNameIndex::clear() {
+	//Swap the storage out rather than clearing, since it's about to go back to the arena
+	SlotVector(_slots.get_allocator()).swap(_slots);
+	_used = 0;
+}
+
+guint32 NodeNameIndex::hashName(const gchar* name) {
+	//FNV-1a; never 0, since 0 marks an uncached hash
+	guint32 hash = 2166136261U;
+	for (const guchar* ch = reinterpret_cast<const guchar*>(name); *ch; ch++) {
+		hash ^= *ch;
+		hash *= 16777619U;
+	}
+
+	return hash ? hash : 1;
+}
+
+guint32 NodeNameIndex::hashNode(ProtocolTreeNode* node) {
+	int hfId = node->getProtoNode()->finfo->hfinfo->id;
+	if (hfId < 0) {
+		return hashName(node->getName());
+	}
+
+	size_t idx = static_cast<size_t>(hfId);
+	if (idx >= s_hashesByHfId.size()) {
+		s_hashesByHfId.resize(idx + 1, 0);
+	}
+
+	if (!s_hashesByHfId[idx]) {
+		s_hashesByHfId[idx] = hashName(node->getName());
+	}
+
+	return s_hashesByHfId[idx];
+}
+
+size_t NodeNameIndex::findSlot(const gchar* name, guint32 hash) const {
+	size_t mask = _slots.size() - 1;
+	size_t idx = hash & mask;
+
+	//Linear probing.  Names are almost always the registrar's own abbrev strings, so a pointer
+	//comparison usually settles it before strcmp is needed
+	while (_slots[idx].name) {
+		const Slot& slot = _slots[idx];
+		if (slot.hash == hash && (slot.name == name || ::strcmp(slot.name, name) == 0)) {
+			break;
+		}
+
+		idx = (idx + 1) & mask;
+	}
+
+	return idx;
+}
+
+void NodeNameIndex::grow() {
+	//The old slots stay in the arena until it's reset
+	SlotVector oldSlots(_slots.get_allocator());
+	oldSlots.swap(_slots);
+
+	Slot empty = { NULL, 0, NULL, NULL };
+	_slots.assign(oldSlots.size() * 2, empty);
+
+	for (SlotVector::const_iterator iter = oldSlots.begin();
+		iter != oldSlots.end();
+		++iter) {
+		if (iter->name) {
+			_slots[findSlot(iter->name, iter->hash)] = *iter;
+		}
+	}
+}
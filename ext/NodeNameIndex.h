@@ -0,0 +1,59 @@
+#pragma once
+
+#include "RubyAndShit.h"
+#include "PacketArena.h"
+
+#include <vector>
+
+class ProtocolTreeNode;
+
+/** Per-packet index of protocol tree nodes by field name, for find_first_field, each_field and friends.
+ *
+ *  An open-addressing hash table with one slot per distinct name, each heading a list of that name's
+ *  nodes threaded through ProtocolTreeNode::getNextWithSameName.  Nodes are indexed in ordinal order,
+ *  so each list is already in ordinal order.  A name's hash is computed once per header field and
+ *  cached by hf id, so indexing a node never touches its name; only lookups hash a string.  The slots
+ *  are allocated from the packet's arena */
+class NodeNameIndex
+{
+public:
+	NodeNameIndex(PacketArena& arena);
+	virtual ~NodeNameIndex(void);
+
+	/** Adds a node to the end of its name's list */
+	void insert(ProtocolTreeNode* node);
+
+	/** Gets the first node with the given name, or NULL if there isn't one */
+	ProtocolTreeNode* findFirst(const gchar* name) const;
+
+	/** Empties the index and lets go of its storage, ahead of the arena being reset */
+	void clear();
+
+private:
+	struct Slot {
+		/** The name shared by the nodes in this slot, or NULL if the slot is empty */
+		const gchar* name;
+		guint32 hash;
+		ProtocolTreeNode* first;
+		ProtocolTreeNode* last;
+	};
+
+	typedef std::vector<Slot, ArenaAllocator<Slot> > SlotVector;
+
+	static guint32 hashName(const gchar* name);
+
+	/** Gets the hash of a node's name, from the per-hf id cache if possible */
+	static guint32 hashNode(ProtocolTreeNode* node);
+
+	/** Finds the slot for a name: either the one holding it, or the empty slot where it would go */
+	size_t findSlot(const gchar* name, guint32 hash) const;
+
+	/** Doubles the number of slots and re-inserts the names */
+	void grow();
+
+	SlotVector _slots;
+	size_t _used;
+
+	/** Name hashes by hf id, shared by every packet; 0 means not yet computed */
+	static std::vector<guint32> s_hashesByHfId;
+};
@@ -0,0 +1,138 @@
+#include "NodeTable.h"
+#include "ProtocolTreeNode.h"
+
+/** The number of slots a fresh table starts out with; must be a power of two */
+#define INITIAL_NODE_TABLE_SLOTS                256
+
+const guint NodeTable::NO_NODE;
+
+NodeTable::NodeTable(PacketArena& arena) :
+	_nodes(ArenaAllocator<ProtocolTreeNode*>(arena)),
+	_links(ArenaAllocator<Links>(arena)),
+	_slots(ArenaAllocator<Slot>(arena))
+{
+	_firstRoot = NO_NODE;
+	_lastRoot = NO_NODE;
+}
+
+NodeTable::~NodeTable(void)
+{
+}
+
+void NodeTable::add(ProtocolTreeNode* node) {
+	//Keep the load factor at or below one half, so probe sequences stay short
+	if (_slots.empty()) {
+		Slot empty = { NULL, NO_NODE };
+		_slots.assign(INITIAL_NODE_TABLE_SLOTS, empty);
+	} else if ((_nodes.size() + 1) * 2 > _slots.size()) {
+		grow();
+	}
+
+	guint ordinal = static_cast<guint>(_nodes.size());
+	g_assert(node->getOrdinal() == ordinal);
+
+	Links links = { NO_NODE, NO_NODE, NO_NODE, NO_NODE, ordinal + 1 };
+
+	if (node->getParentNode()) {
+		guint parent = node->getParentNode()->getOrdinal();
+		links.parent = parent;
+
+		if (_links[parent].lastChild == NO_NODE) {
+			_links[parent].firstChild = ordinal;
+		} else {
+			_links[_links[parent].lastChild].nextSibling = ordinal;
+		}
+		_links[parent].lastChild = ordinal;
+
+		//The new node extends the subtree of every one of its ancestors
+		for (guint ancestor = parent; ancestor != NO_NODE; ancestor = _links[ancestor].parent) {
+			_links[ancestor].subtreeEnd = ordinal + 1;
+		}
+	} else {
+		if (_lastRoot == NO_NODE) {
+			_firstRoot = ordinal;
+		} else {
+			_links[_lastRoot].nextSibling = ordinal;
+		}
+		_lastRoot = ordinal;
+	}
+
+	_nodes.push_back(node);
+	_links.push_back(links);
+
+	Slot& slot = _slots[findSlot(node->getProtoNode())];
+	slot.key = node->getProtoNode();
+	slot.ordinal = ordinal;
+}
+
+ProtocolTreeNode* NodeTable::find(const proto_node* node) const {
+	if (!node || _nodes.empty()) {
+		return NULL;
+	}
+
+	const Slot& slot = _slots[findSlot(node)];
+	return slot.key ? _nodes[slot.ordinal] : NULL;
+}
+
+ProtocolTreeNode* NodeTable::getFirstChild(const ProtocolTreeNode* parent) const {
+	guint ordinal = parent ? _links[parent->getOrdinal()].firstChild : _firstRoot;
+	return ordinal == NO_NODE ? NULL : _nodes[ordinal];
+}
+
+ProtocolTreeNode* NodeTable::getNextSibling(const ProtocolTreeNode* node) const {
+	guint ordinal = _links[node->getOrdinal()].nextSibling;
+	return ordinal == NO_NODE ? NULL : _nodes[ordinal];
+}
+
+guint NodeTable::getSubtreeEnd(const ProtocolTreeNode* node) const {
+	return _links[node->getOrdinal()].subtreeEnd;
+}
+
+gboolean NodeTable::isDescendant(const ProtocolTreeNode* node, const ProtocolTreeNode* ancestor) const {
+	return node->getOrdinal() > ancestor->getOrdinal() && 
+		node->getOrdinal() < _links[ancestor->getOrdinal()].subtreeEnd;
+}
+
+void NodeTable::clear() {
+	//Swap the storage out rather than clearing, since it's about to go back to the arena
+	NodeVector(_nodes.get_allocator()).swap(_nodes);
+	LinksVector(_links.get_allocator()).swap(_links);
+	SlotVector(_slots.get_allocator()).swap(_slots);
+	_firstRoot = NO_NODE;
+	_lastRoot = NO_NODE;
+}
+
+size_t NodeTable::hashPointer(const proto_node* node) {
+	//proto_nodes come out of an allocator with at least 8 byte alignment, so the low bits carry
+	//nothing; drop them and scramble the rest with a Fibonacci multiplier
+	size_t bits = reinterpret_cast<size_t>(node) >> 3;
+	return static_cast<size_t>(static_cast<guint32>(bits) * 2654435769U) ^ (bits >> 16);
+}
+
+size_t NodeTable::findSlot(const proto_node* node) const {
+	size_t mask = _slots.size() - 1;
+	size_t idx = hashPointer(node) & mask;
+
+	while (_slots[idx].key && _slots[idx].key != node) {
+		idx = (idx + 1) & mask;
+	}
+
+	return idx;
+}
+
+void NodeTable::grow() {
+	//The old slots stay in the arena until it's reset
+	SlotVector oldSlots(_slots.get_allocator());
+	oldSlots.swap(_slots);
+
+	Slot empty = { NULL, NO_NODE };
+	_slots.assign(oldSlots.size() * 2, empty);
+
+	for (SlotVector::const_iterator iter = oldSlots.begin();
+		iter != oldSlots.end();
+		++iter) {
+		if (iter->key) {
+			_slots[findSlot(iter->key)] = *iter;
+		}
+	}
+}
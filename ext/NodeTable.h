@@ -0,0 +1,101 @@
+#pragma once
+
+#include "RubyAndShit.h"
+#include "PacketArena.h"
+
+#include <vector>
+
+class ProtocolTreeNode;
+
+/** Per-packet table of protocol tree nodes, indexed by ordinal.
+ *
+ *  Alongside each node the table keeps the ordinals of its parent, first and last child, and next
+ *  sibling, so walking a node's children or finding its parent is a couple of array reads rather
+ *  than a search.  Finding the node that wraps a given proto_node goes through an open-addressing
+ *  hash keyed by the proto_node's address.  All of the table's storage comes from the packet's arena.
+ *
+ *  Nodes must be added in pre-order, each before its descendants and after every node in the subtrees
+ *  ahead of it, which is the order Packet walks the protocol tree in.  A node's descendants are then
+ *  exactly the nodes whose ordinals run from its own up to its subtree end, so scanning a subtree is a
+ *  walk along a slice of the table, and telling whether one node is beneath another takes two
+ *  comparisons */
+class NodeTable
+{
+public:
+	typedef std::vector<ProtocolTreeNode*, ArenaAllocator<ProtocolTreeNode*> > NodeVector;
+	typedef NodeVector::const_iterator const_iterator;
+
+	/** Marks a missing parent, child or sibling */
+	static const guint NO_NODE = G_MAXUINT;
+
+	NodeTable(PacketArena& arena);
+	virtual ~NodeTable(void);
+
+	/** Adds a node whose ordinal is the current size of the table, as the last child of its parent
+	node, or as the last root node if it hasn't got one */
+	void add(ProtocolTreeNode* node);
+
+	size_t size() const { return _nodes.size(); }
+	gboolean empty() const { return _nodes.empty(); }
+
+	ProtocolTreeNode* at(guint ordinal) const { return ordinal < _nodes.size() ? _nodes[ordinal] : NULL; }
+
+	const_iterator begin() const { return _nodes.begin(); }
+	const_iterator end() const { return _nodes.end(); }
+
+	/** Gets the node wrapping a proto_node, or NULL if the proto_node isn't in the table */
+	ProtocolTreeNode* find(const proto_node* node) const;
+
+	/** Gets a node's first child, or if 'parent' is NULL, the first root node */
+	ProtocolTreeNode* getFirstChild(const ProtocolTreeNode* parent) const;
+
+	/** Gets the node following a node under the same parent */
+	ProtocolTreeNode* getNextSibling(const ProtocolTreeNode* node) const;
+
+	/** Gets the ordinal just past a node's last descendant, or just past the node itself if it has no
+	descendants */
+	guint getSubtreeEnd(const ProtocolTreeNode* node) const;
+
+	/** True if 'node' is a descendant of 'ancestor' */
+	gboolean isDescendant(const ProtocolTreeNode* node, const ProtocolTreeNode* ancestor) const;
+
+	/** Empties the table and lets go of its storage, ahead of the arena being reset */
+	void clear();
+
+private:
+	struct Links {
+		guint parent;
+		guint firstChild;
+		guint lastChild;
+		guint nextSibling;
+		guint subtreeEnd;
+	};
+
+	struct Slot {
+		/** The proto_node wrapped by the node in this slot, or NULL if the slot is empty */
+		const proto_node* key;
+		guint ordinal;
+	};
+
+	typedef std::vector<Links, ArenaAllocator<Links> > LinksVector;
+	typedef std::vector<Slot, ArenaAllocator<Slot> > SlotVector;
+
+	static size_t hashPointer(const proto_node* node);
+
+	/** Finds the slot for a proto_node: either the one holding it, or the empty slot where it would go */
+	size_t findSlot(const proto_node* node) const;
+
+	/** Doubles the number of slots and re-inserts the nodes */
+	void grow();
+
+	NodeVector _nodes;
+
+	/** Tree links for each node, parallel to _nodes */
+	LinksVector _links;
+
+	/** The first and last root nodes */
+	guint _firstRoot;
+	guint _lastRoot;
+
+	SlotVector _slots;
+};
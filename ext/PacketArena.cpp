@@ -0,0 +1,84 @@
+#include "PacketArena.h"
+
+/** Every allocation is rounded up to a multiple of this, which suits any type a node or index holds */
+#define PACKET_ARENA_ALIGNMENT                  8
+
+PacketArena::Chunk* PacketArena::s_freeChunks = NULL;
+size_t PacketArena::s_freeChunkCount = 0;
+
+PacketArena::PacketArena(void)
+{
+	_chunks = NULL;
+	_next = NULL;
+	_end = NULL;
+	_bytesAllocated = 0;
+}
+
+PacketArena::~PacketArena(void)
+{
+	reset();
+}
+
+void* PacketArena::allocate(size_t numBytes) {
+	numBytes = alignSize(numBytes);
+
+	if (static_cast<size_t>(_end - _next) < numBytes) {
+		addChunk(numBytes);
+	}
+
+	void* block = _next;
+	_next += numBytes;
+	_bytesAllocated += numBytes;
+
+	return block;
+}
+
+void PacketArena::reset() {
+	while (_chunks) {
+		Chunk* chunk = _chunks;
+		_chunks = chunk->next;
+
+		//Oversized chunks were made for a single big allocation; don't let them pile up in the pool
+		if (chunk->size == PACKET_ARENA_CHUNK_SIZE && s_freeChunkCount < MAX_POOLED_ARENA_CHUNKS) {
+			chunk->next = s_freeChunks;
+			s_freeChunks = chunk;
+			s_freeChunkCount++;
+		} else {
+			::g_free(chunk);
+		}
+	}
+
+	_next = NULL;
+	_end = NULL;
+	_bytesAllocated = 0;
+}
+
+void PacketArena::addChunk(size_t numBytes) {
+	size_t headerSize = alignSize(sizeof(Chunk));
+	Chunk* chunk = NULL;
+
+	if (headerSize + numBytes <= PACKET_ARENA_CHUNK_SIZE) {
+		if (s_freeChunks) {
+			chunk = s_freeChunks;
+			s_freeChunks = chunk->next;
+			s_freeChunkCount--;
+		} else {
+			chunk = static_cast<Chunk*>(::g_malloc(PACKET_ARENA_CHUNK_SIZE));
+			chunk->size = PACKET_ARENA_CHUNK_SIZE;
+		}
+	} else {
+		chunk = static_cast<Chunk*>(::g_malloc(headerSize + numBytes));
+		chunk->size = headerSize + numBytes;
+	}
+
+	//Whatever is left of the current chunk is abandoned until the next reset
+	chunk->next = _chunks;
+	_chunks = chunk;
+
+	_next = reinterpret_cast<guint8*>(chunk) + headerSize;
+	_end = reinterpret_cast<guint8*>(chunk) + chunk->size;
+}
+
+size_t PacketArena::alignSize(size_t numBytes) {
+	return (numBytes + PACKET_ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(PACKET_ARENA_ALIGNMENT - 1);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "RubyAndShit.h"
+
+#include <new>
+
+/** The size of each block of memory a PacketArena carves allocations out of */
+#define PACKET_ARENA_CHUNK_SIZE                 (64 * 1024)
+
+/** The most unused chunks kept for reuse by later packets; any more are freed outright.  Enough for
+ *  a default-sized batch from each_packet_batch, at a chunk or two per packet */
+#define MAX_POOLED_ARENA_CHUNKS                 128
+
+/** Bump allocator for memory that lives exactly as long as a packet's dissection: the ProtocolTreeNodes
+ *  and the storage behind the node table and name index.
+ *
+ *  Allocation advances a pointer through the current chunk, taking another chunk when it runs out.
+ *  Nothing is freed individually; reset() hands every chunk back at once, so whatever was built in the
+ *  arena must not need its destructor run.  Chunks released by one packet are pooled, process-wide,
+ *  for the next, so a steady stream of packets doesn't touch the heap at all */
+class PacketArena
+{
+public:
+	PacketArena(void);
+	virtual ~PacketArena(void);
+
+	/** Allocates a block suitably aligned for any type.  Never returns NULL */
+	void* allocate(size_t numBytes);
+
+	/** Releases everything allocated from the arena, returning its chunks to the pool */
+	void reset();
+
+	/** The number of bytes handed out since the last reset */
+	size_t getBytesAllocated() const { return _bytesAllocated; }
+
+private:
+	/** Header at the start of each chunk; the allocations follow it */
+	struct Chunk {
+		Chunk* next;
+		size_t size;
+	};
+
+	//No copy ctor, and no assignment
+	PacketArena(const PacketArena&);
+	PacketArena& operator=(const PacketArena&);
+
+	/** Starts a new chunk big enough for at least numBytes */
+	void addChunk(size_t numBytes);
+
+	static size_t alignSize(size_t numBytes);
+
+	/** The chunks in use, most recent first */
+	Chunk* _chunks;
+
+	/** The next free byte in the current chunk, and the end of it */
+	guint8* _next;
+	guint8* _end;
+
+	size_t _bytesAllocated;
+
+	/** Chunks no packet is using */
+	static Chunk* s_freeChunks;
+	static size_t s_freeChunkCount;
+};
+
+/** STL allocator that takes its memory from a PacketArena, so per-packet containers can be emptied by
+ *  resetting the arena.  deallocate does nothing; the storage is reclaimed when the arena is reset, so a
+ *  container using this allocator must be emptied of its storage before then */
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <typename U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	explicit ArenaAllocator(PacketArena& arena) : _arena(&arena) {
+	}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.getArena()) {
+	}
+
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
+
+	pointer allocate(size_type n, const void* = 0) {
+		return static_cast<pointer>(_arena->allocate(n * sizeof(T)));
+	}
+
+	void deallocate(pointer, size_type) {
+	}
+
+	size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+
+	void construct(pointer p, const T& val) { new(static_cast<void*>(p)) T(val); }
+	void destroy(pointer p) { p->~T(); }
+
+	PacketArena* getArena() const { return _arena; }
+
+private:
+	PacketArena* _arena;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+	return lhs.getArena() == rhs.getArena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+	return lhs.getArena() != rhs.getArena();
+}
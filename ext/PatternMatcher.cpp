@@ -0,0 +1,77 @@
+#include "PatternMatcher.h"
+
+/** Bits of Regexp#options; the values of Regexp::IGNORECASE, Regexp::EXTENDED and Regexp::MULTILINE */
+#define RUBY_REGEXP_IGNORECASE                  1
+#define RUBY_REGEXP_EXTENDED                    2
+#define RUBY_REGEXP_MULTILINE                   4
+
+PatternMatcher* PatternMatcher::compile(VALUE pattern) {
+	if (TYPE(pattern) == T_STRING) {
+		return new PatternMatcher(NULL, ::g_pattern_spec_new(RSTRING(pattern)->ptr));
+	}
+
+	if (!::rb_obj_is_kind_of(pattern, ::rb_cRegexp)) {
+		::rb_raise(::rb_eTypeError, "wrong argument type %s (expected Regexp or String)",
+			::rb_obj_classname(pattern));
+	}
+
+	VALUE source = ::rb_funcall(pattern, ::rb_intern("source"), 0);
+	int options = NUM2INT(::rb_funcall(pattern, ::rb_intern("options"), 0));
+
+	//In Ruby, ^ and $ always match at line breaks, and the MULTILINE option is what lets . match them.
+	//Ruby 1.8 strings are bytes, and display values can hold any byte, so neither the pattern nor
+	//the subject can be assumed to be valid UTF-8
+	int flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE | G_REGEX_RAW;
+	if (options & RUBY_REGEXP_IGNORECASE) {
+		flags |= G_REGEX_CASELESS;
+	}
+	if (options & RUBY_REGEXP_EXTENDED) {
+		flags |= G_REGEX_EXTENDED;
+	}
+	if (options & RUBY_REGEXP_MULTILINE) {
+		flags |= G_REGEX_DOTALL;
+	}
+
+	GError* error = NULL;
+	GRegex* regex = ::g_regex_new(RSTRING(source)->ptr,
+		static_cast<GRegexCompileFlags>(flags),
+		static_cast<GRegexMatchFlags>(0),
+		&error);
+	if (regex == NULL) {
+		VALUE message = ::rb_str_new2(error ? error->message : "invalid regular expression");
+		if (error) {
+			::g_error_free(error);
+		}
+		::rb_raise(::rb_eArgError, "Regexp /%s/ can't be compiled natively: %s",
+			RSTRING(source)->ptr,
+			RSTRING(message)->ptr);
+	}
+
+	return new PatternMatcher(regex, NULL);
+}
+
+PatternMatcher::PatternMatcher(GRegex* regex, GPatternSpec* glob) {
+	_regex = regex;
+	_glob = glob;
+}
+
+PatternMatcher::~PatternMatcher(void) {
+	if (_regex) {
+		::g_regex_unref(_regex);
+	}
+	if (_glob) {
+		::g_pattern_spec_free(_glob);
+	}
+}
+
+bool PatternMatcher::matches(const gchar* str) const {
+	if (str == NULL) {
+		str = "";
+	}
+
+	if (_regex) {
+		return ::g_regex_match(_regex, str, static_cast<GRegexMatchFlags>(0), NULL) ? true : false;
+	}
+
+	return ::g_pattern_match_string(_glob, str) ? true : false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "RubyAndShit.h"
+
+/** A glob or regular expression compiled once with glib, so field names and display values can be matched against
+ *  it natively, without making Ruby strings of them.
+ *
+ *  A Ruby Regexp compiles to a GRegex, keeping its IGNORECASE, EXTENDED and MULTILINE options.  A String is a
+ *  glob as GPatternSpec understands it, where '*' matches any run of characters and '?' any one character, and
+ *  which must match the whole string, so "wlan_mgt.tag.*" matches every WLAN management tag field */
+class PatternMatcher
+{
+public:
+	/** Compiles a Regexp or a glob String.  Raises ArgumentError if a Regexp is one GRegex can't compile, and
+	TypeError for anything else */
+	static PatternMatcher* compile(VALUE pattern);
+
+	virtual ~PatternMatcher(void);
+
+	/** True if the string matches the pattern; a NULL string is matched as an empty one */
+	bool matches(const gchar* str) const;
+
+private:
+	PatternMatcher(GRegex* regex, GPatternSpec* glob);
+
+	//No copy ctor, and no assignment
+	PatternMatcher(const PatternMatcher&);
+	PatternMatcher& operator=(const PatternMatcher&);
+
+	/** Exactly one of these is set */
+	GRegex* _regex;
+	GPatternSpec* _glob;
+};
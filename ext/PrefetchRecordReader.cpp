@@ -0,0 +1,220 @@
+#include "PrefetchRecordReader.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <pthread.h>
+#endif
+
+PrefetchRecordReader::PrefetchRecordReader(RecordReader* inner, size_t depth)
+{
+	_inner = inner;
+	_depth = depth > 0 ? depth : 1;
+
+	_slots = new Slot[_depth];
+	::memset(_slots, 0, sizeof(Slot) * _depth);
+
+	_readIndex = 0;
+	_writeIndex = 0;
+	_count = 0;
+	_holdingSlot = false;
+	_finished = false;
+	_err = 0;
+	_errInfo = NULL;
+	_stopping = false;
+
+	_lock = ::g_mutex_new();
+	_notEmpty = ::g_cond_new();
+	_notFull = ::g_cond_new();
+
+	//Start reading right away, so the first few frames are already buffered by the time
+	//the caller starts iterating
+	startThread();
+}
+
+PrefetchRecordReader::~PrefetchRecordReader(void)
+{
+	if (_thread) {
+		::g_mutex_lock(_lock);
+		_stopping = true;
+		::g_cond_broadcast(_notFull);
+		::g_mutex_unlock(_lock);
+
+		::g_thread_join(_thread);
+		_thread = NULL;
+	}
+
+	::g_cond_free(_notFull);
+	::g_cond_free(_notEmpty);
+	::g_mutex_free(_lock);
+
+	for (size_t idx = 0; idx < _depth; idx++) {
+		::g_free(_slots[idx].data);
+	}
+	delete[] _slots;
+
+	if (_errInfo) {
+		::g_free(_errInfo);
+	}
+
+	delete _inner;
+}
+
+gboolean PrefetchRecordReader::readNext(RawRecord& record, int* err, gchar** errInfo) {
+	*err = 0;
+
+	if (!_thread) {
+		//Couldn't start the background thread, so just read in the foreground
+		return _inner->readNext(record, err, errInfo);
+	}
+
+	::g_mutex_lock(_lock);
+
+	//The record returned by the last call is no longer needed, so its slot can be reused
+	if (_holdingSlot) {
+		_readIndex = (_readIndex + 1) % _depth;
+		_count--;
+		_holdingSlot = false;
+		::g_cond_signal(_notFull);
+	}
+
+	while (_count == 0 && !_finished) {
+		::g_cond_wait(_notEmpty, _lock);
+	}
+
+	if (_count == 0) {
+		//Everything buffered has been consumed; report how the inner reader ended
+		*err = _err;
+		if (_errInfo) {
+			*errInfo = _errInfo;
+			_errInfo = NULL;
+		}
+
+		::g_mutex_unlock(_lock);
+		return FALSE;
+	}
+
+	Slot& slot = _slots[_readIndex];
+	_holdingSlot = true;
+
+	::g_mutex_unlock(_lock);
+
+	record.phdr = &slot.phdr;
+	record.pseudoHeader = &slot.pseudoHeader;
+	record.data = slot.data;
+	record.offset = slot.offset;
+
+	return TRUE;
+}
+
+bool PrefetchRecordReader::refresh() {
+	if (!_thread) {
+		return _inner->refresh();
+	}
+
+	::g_mutex_lock(_lock);
+	bool drained = _finished && _count == 0;
+	::g_mutex_unlock(_lock);
+
+	if (!drained) {
+		//Still records to hand out before the end is reached
+		return true;
+	}
+
+	//The background thread exits once it reaches the end, so it can be joined without waiting
+	::g_thread_join(_thread);
+	_thread = NULL;
+
+	if (!_inner->refresh()) {
+		return false;
+	}
+
+	if (_errInfo) {
+		::g_free(_errInfo);
+		_errInfo = NULL;
+	}
+	_err = 0;
+	_finished = false;
+
+	startThread();
+
+	return true;
+}
+
+void PrefetchRecordReader::startThread() {
+	_thread = ::g_thread_create(PrefetchRecordReader::threadProc, this, TRUE, NULL);
+}
+
+gpointer PrefetchRecordReader::threadProc(gpointer param) {
+	PrefetchRecordReader* reader = reinterpret_cast<PrefetchRecordReader*>(param);
+
+#ifndef _WIN32
+	//Ruby's signal handlers (including its thread timer) must only ever run on the interpreter's
+	//thread, so keep every signal away from this one
+	sigset_t allSignals;
+	::sigfillset(&allSignals);
+	::pthread_sigmask(SIG_BLOCK, &allSignals, NULL);
+#endif
+
+	reader->readAhead();
+
+	return NULL;
+}
+
+void PrefetchRecordReader::readAhead() {
+	for (;;) {
+		::g_mutex_lock(_lock);
+		while (_count == _depth && !_stopping) {
+			::g_cond_wait(_notFull, _lock);
+		}
+
+		if (_stopping) {
+			::g_mutex_unlock(_lock);
+			return;
+		}
+
+		//The slot at _writeIndex isn't visible to the consumer until _count is incremented, so
+		//it can be filled without holding the lock
+		Slot& slot = _slots[_writeIndex];
+		::g_mutex_unlock(_lock);
+
+		RawRecord record;
+		int err = 0;
+		gchar* errInfo = NULL;
+		gboolean gotRecord = _inner->readNext(record, &err, &errInfo);
+		if (gotRecord) {
+			fillSlot(slot, record);
+		}
+
+		::g_mutex_lock(_lock);
+		if (gotRecord) {
+			_writeIndex = (_writeIndex + 1) % _depth;
+			_count++;
+		} else {
+			_finished = true;
+			_err = err;
+			_errInfo = errInfo;
+		}
+		::g_cond_signal(_notEmpty);
+		::g_mutex_unlock(_lock);
+
+		if (!gotRecord) {
+			return;
+		}
+	}
+}
+
+void PrefetchRecordReader::fillSlot(Slot& slot, const RawRecord& record) {
+	guint32 caplen = record.phdr->caplen;
+
+	if (slot.data == NULL || slot.dataCapacity < caplen) {
+		//Grow past the largest frame seen so far, rounded up, so the buffer is rarely reallocated
+		guint32 capacity = (caplen | 0xff) + 1;
+		slot.data = reinterpret_cast<guchar*>(::g_realloc(slot.data, capacity));
+		slot.dataCapacity = capacity;
+	}
+
+	slot.phdr = *record.phdr;
+	slot.pseudoHeader = *record.pseudoHeader;
+	::memcpy(slot.data, record.data, caplen);
+	slot.offset = record.offset;
+}
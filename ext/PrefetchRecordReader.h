@@ -0,0 +1,77 @@
+#pragma once
+
+#include "RecordReader.h"
+
+/** The number of raw records read ahead of the frame being dissected, unless
+ *  CapFile.set_read_ahead_depth says otherwise */
+#define DEFAULT_READ_AHEAD_DEPTH                256
+
+/** RecordReader which reads records from another RecordReader on a background thread, into a
+ *  bounded ring of copies, so the disk I/O for upcoming frames overlaps with the dissection of the
+ *  current one.
+ *
+ *  Records come out in exactly the order the inner reader produced them, and read errors are
+ *  reported from readNext only after every record read before the error has been consumed.  The
+ *  background thread never touches Ruby or epan; only the inner reader */
+class PrefetchRecordReader : public RecordReader
+{
+public:
+	/** Takes ownership of 'inner', which from now on must only be used by this object.  'depth' is the
+	number of records that can be buffered ahead of the consumer, and must be at least 1 */
+	PrefetchRecordReader(RecordReader* inner, size_t depth);
+	virtual ~PrefetchRecordReader(void);
+
+	virtual gboolean readNext(RawRecord& record, int* err, gchar** errInfo);
+
+	/** Once everything buffered has been consumed, refreshes the inner reader and starts reading ahead again */
+	virtual bool refresh();
+
+private:
+	/** One record's worth of buffered data */
+	struct Slot {
+		struct wtap_pkthdr phdr;
+		union wtap_pseudo_header pseudoHeader;
+		guchar* data;
+		guint32 dataCapacity;
+		gint64 offset;
+	};
+
+	static gpointer threadProc(gpointer param);
+
+	/** Body of the background thread */
+	void readAhead();
+
+	/** Starts the background thread; if it can't be started, records are read in the foreground */
+	void startThread();
+
+	/** Copies 'record' into 'slot', growing the slot's buffer if necessary */
+	static void fillSlot(Slot& slot, const RawRecord& record);
+
+	RecordReader* _inner;
+
+	Slot* _slots;
+	size_t _depth;
+
+	/** Ring indexes.  _readIndex is the slot the consumer will get next; _writeIndex is the slot the
+	background thread will fill next.  _count is the number of filled slots, including the one the
+	consumer holds, if any */
+	size_t _readIndex;
+	size_t _writeIndex;
+	size_t _count;
+
+	/** True if the consumer is still using the slot at _readIndex from its last readNext call */
+	bool _holdingSlot;
+
+	/** Set once the inner reader has hit the end of the file or an error; _err and _errInfo say which */
+	bool _finished;
+	int _err;
+	gchar* _errInfo;
+
+	/** Set by the destructor to tell the background thread to quit */
+	bool _stopping;
+
+	GMutex* _lock;
+	GCond* _notEmpty;
+	GCond* _notFull;
+	GThread* _thread;
+};
@@ -8,23 +8,18 @@ extern "C" {
 #include "epan/dissectors/packet-data.h"
 }
 
-ProtocolTreeNode::ProtocolTreeNode(VALUE packet, epan_dissect_t* edt, guint ordinal, proto_node* node, ProtocolTreeNode* parentNode)
+ProtocolTreeNode::ProtocolTreeNode(ProtocolTreeNodeContext* context, guint ordinal, proto_node* node, ProtocolTreeNode* parentNode)
 {
 	_name = NULL;
-	_displayName = NULL;
-	_displayNameComputed = FALSE;
-	_value = NULL;
-	_valueComputed = FALSE;
-	_displayValue = NULL;
-	_displayValueComputed = FALSE;
 	_length = 0;
 	_position = 0;
-	_isProtocol = FALSE;
-	_edt = edt;
+	_flags = 0;
+	_context = context;
+	_details = NULL;
 	_ordinal = ordinal;
 	_node = node;
 	_parentNode = parentNode;
-	_packet = packet;
+	_nextWithSameName = NULL;
 	_fieldObject = Qnil;
 
 	//Pre-compute the node name
@@ -45,24 +40,12 @@ ProtocolTreeNode::ProtocolTreeNode(VALUE packet, epan_dissect_t* edt, guint ordi
 	_length = fi->length;
 	_position = fi->start;
 
-	//FIgure out if this is a protocol or a field
-	/* Text label. It's printed as a field with no name. */
-	if (fi->hfinfo->id == hf_text_only) {
-		_isProtocol = FALSE;
-	}
-	/* Uninterpreted data, i.e., the "Data" protocol, is
-	 * printed as a field instead of a protocol. */
-	else if (fi->hfinfo->id == proto_data) {
-		_isProtocol = FALSE;
-	}
-	/* Normal protocols and fields */
-	else {
-		if (fi->hfinfo->type == FT_PROTOCOL) {
-			_isProtocol = TRUE;
-		}
-		else {
-			_isProtocol = FALSE;
-		}
+	//FIgure out if this is a protocol or a field.  Text labels are printed as a field with no name, and
+	//uninterpreted data, i.e., the "Data" protocol, is printed as a field instead of a protocol
+	if (fi->hfinfo->id != hf_text_only &&
+		fi->hfinfo->id != proto_data &&
+		fi->hfinfo->type == FT_PROTOCOL) {
+		_flags |= IS_PROTOCOL;
 	}
 }
 
@@ -70,72 +53,76 @@ ProtocolTreeNode::~ProtocolTreeNode(void)
 {
 }
 
-const gchar* ProtocolTreeNode::getName() {
-	return _name;
-}
-
 const gchar* ProtocolTreeNode::getDisplayName()  {
-	if (!_displayNameComputed) {
+	Details& details = getDetails();
+
+	if (!(_flags & DISPLAY_NAME_COMPUTED)) {
 		//Compute a display name
 		field_info	*fi = PITEM_FINFO(_node);
 
 		/* Text label. It's printed as a field with no name. */
 		if (fi->hfinfo->id == hf_text_only) {
-			_displayName = NULL;
+			details.displayName = NULL;
 		}
 		/* Uninterpreted data, i.e., the "Data" protocol, is
 		 * printed as a field instead of a protocol. */
 		else if (fi->hfinfo->id == proto_data) {
-			_displayName = NULL;
+			details.displayName = NULL;
 		}
 		/* Normal protocols and fields */
 		else {
 			if (fi->rep) {
-				_displayName = fi->rep->representation;
+				details.displayName = fi->rep->representation;
 			}
 			else {
-				::proto_item_fill_label(fi, _displayNameBuffer);
-				_displayName = _displayNameBuffer;
+				//Only now is a label buffer needed; it lives as long as the packet's other nodes
+				gchar* label = static_cast<gchar*>(_context->arena->allocate(ITEM_LABEL_LENGTH));
+				::proto_item_fill_label(fi, label);
+				details.displayName = label;
 			}
 		}
 
-		_displayNameComputed = TRUE;
+		_flags |= DISPLAY_NAME_COMPUTED;
 	}
 
-	return _displayName;
+	return details.displayName;
 }
 
 const guchar* ProtocolTreeNode::getValue() {
-	if (!_valueComputed) {
+	Details& details = getDetails();
+
+	if (!(_flags & VALUE_COMPUTED)) {
 		field_info	*fi = PITEM_FINFO(_node);
 
         if (fi->length > 0) {
-            _value = getValueForField(fi);
+            details.value = getValueForField(fi);
         }
 
-		_valueComputed = TRUE;
+		_flags |= VALUE_COMPUTED;
 	}
 
-	return _value;
+	return details.value;
 }
 
 const gchar* ProtocolTreeNode::getDisplayValue() {
-	if (!_displayValueComputed) {
+	Details& details = getDetails();
+
+	if (!(_flags & DISPLAY_VALUE_COMPUTED)) {
 		field_info	*fi = PITEM_FINFO(_node);
 
 		/* Text label. It's printed as a field with no name. */
 		if (fi->hfinfo->id == hf_text_only) {
 			if (fi->rep) {
-				_displayValue = fi->rep->representation;
+				details.displayValue = fi->rep->representation;
 			}
 			else {
-				_displayValue = "";
+				details.displayValue = "";
 			}
 		}
 		/* Uninterpreted data, i.e., the "Data" protocol, is
 		 * printed as a field instead of a protocol. */
 		else if (fi->hfinfo->id == proto_data) {
-			_displayValue = NULL;
+			details.displayValue = NULL;
 		}
 		/* Normal protocols and fields */
 		else {
@@ -155,7 +142,7 @@ const gchar* ProtocolTreeNode::getDisplayValue() {
 				in the context of the current packet dissector, thus there's no need to free it here as it 
 				will be freed when the dissector is cleaned up */
 				dfilter_string = ::proto_construct_match_selected_string(fi,
-					_edt);
+					_context->edt);
 				if (dfilter_string != NULL) {
 					chop_len = ::strlen(fi->hfinfo->abbrev) + 4; /* for " == " */
 
@@ -169,31 +156,37 @@ const gchar* ProtocolTreeNode::getDisplayValue() {
 						chop_len++;
 					}
 
-					_displayValue = &dfilter_string[chop_len];
+					details.displayValue = &dfilter_string[chop_len];
 				}
 			}
 		}
-		_displayValueComputed = TRUE;
+		_flags |= DISPLAY_VALUE_COMPUTED;
 	}
 
-	return _displayValue;
+	return details.displayValue;
 }
 
-gboolean ProtocolTreeNode::getIsProtocolNode() {
-	return _isProtocol;
-}
-
-
 VALUE ProtocolTreeNode::getFieldObject() {
 	if (_fieldObject == Qnil) {
 		//Need to create the field object
-		_fieldObject = Field::createField(_packet,
+		_fieldObject = Field::createField(_context->packet,
 			this);
 	}
 
 	return _fieldObject;
 }
 
+ProtocolTreeNode::Details& ProtocolTreeNode::getDetails() {
+	if (!_details) {
+		_details = static_cast<Details*>(_context->arena->allocate(sizeof(Details)));
+		_details->displayName = NULL;
+		_details->value = NULL;
+		_details->displayValue = NULL;
+	}
+
+	return *_details;
+}
+
 const guchar* ProtocolTreeNode::getValueForField(field_info* fi) {
 	if (fi->length > tvb_length_remaining(fi->ds_tvb, fi->start)) {
 		rb_raise(g_capfile_error_class, "field length invalid");
@@ -204,7 +197,7 @@ const guchar* ProtocolTreeNode::getValueForField(field_info* fi) {
 	tvbuff_t *src_tvb;
 	gint length, tvbuff_length;
 
-	for (src_le = _edt->pi.data_src; src_le != NULL; src_le = src_le->next) {
+	for (src_le = _context->edt->pi.data_src; src_le != NULL; src_le = src_le->next) {
 		src = (data_source*)src_le->data;
 		src_tvb = src->tvb;
 		if (fi->ds_tvb == src_tvb) {
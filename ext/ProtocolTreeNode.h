@@ -2,16 +2,30 @@
 
 #include "RubyAndShit.h"
 #include "rcapdissector.h"
+#include "PacketArena.h"
+
+/** What every node in a packet shares: the Ruby Packet object, its dissection, and the arena the nodes'
+lazily computed strings are allocated from.  Owned by the packet, so each node needs just one pointer to it */
+struct ProtocolTreeNodeContext {
+	VALUE packet;
+	epan_dissect_t* edt;
+	PacketArena* arena;
+};
 
 /** A pure native (no Ruby) wrapper around the wireshark proto_node structure, which extracts
-name, value, display name, and display value information from the structure on an ad-hoc basis */
+name, value, display name, and display value information from the structure on an ad-hoc basis.
+
+Nodes are kept small, since a packet has hundreds of them and each_field and friends walk them all: only
+what searching the tree needs is held in the node itself.  The display name, value and display value,
+which few nodes are ever asked for, go in a Details record allocated from the packet's arena the first
+time one of them is computed */
 class ProtocolTreeNode
 {
 public:
-	ProtocolTreeNode(VALUE packet, epan_dissect_t* edt, guint ordinal, proto_node* node, ProtocolTreeNode* parentNode);
+	ProtocolTreeNode(ProtocolTreeNodeContext* context, guint ordinal, proto_node* node, ProtocolTreeNode* parentNode);
 	~ProtocolTreeNode(void);
 
-	const gchar* getName();
+	const gchar* getName() const { return _name; }
 	const gchar* getDisplayName();
 	const guchar* getValue();
 
@@ -20,7 +34,7 @@ public:
 	guint getFieldLength() const { return _length; }
 	guint getPosition() const { return _position; }
 
-	gboolean getIsProtocolNode();
+	gboolean getIsProtocolNode() const { return (_flags & IS_PROTOCOL) ? TRUE : FALSE; }
 
 	/** Gets (or creates if not already created) the Ruby Field object representing this protocol node */
 	VALUE getFieldObject();
@@ -34,55 +48,63 @@ public:
 
 	guint getOrdinal() const { return _ordinal; }
 
-private:
-	/** The name of this node, like 'tcp' or 'wlan.bssid' */
-	const gchar* _name;
-
-	/** The display name of this node, if it has one, else NULL */
-	const gchar* _displayName;
-
-	/** Flag indicates if the display name has been computed yet */
-	gboolean _displayNameComputed;
-
-	/** THe raw binary value of this node if it has one, else NULL */
-	const guchar* _value;
+	/** The next node in the packet, in ordinal order, with the same name as this one; maintained by NodeNameIndex */
+	ProtocolTreeNode* getNextWithSameName() const { return _nextWithSameName; }
+	void setNextWithSameName(ProtocolTreeNode* node) { _nextWithSameName = node; }
 
-	/** Flag indicates if the value has been computed yet */
-	gboolean _valueComputed;
-
-	/** The display value of this node or NULL */
-	const gchar* _displayValue;
+private:
+	enum Flags {
+		/** Set if this is a protocol node; clear if it's a field node */
+		IS_PROTOCOL = 0x01,
+		DISPLAY_NAME_COMPUTED = 0x02,
+		VALUE_COMPUTED = 0x04,
+		DISPLAY_VALUE_COMPUTED = 0x08
+	};
 
-	/** Flag indicates if the display value has been computed yet */
-	gboolean _displayValueComputed;
+	/** The rarely needed, lazily computed parts of a node */
+	struct Details {
+		/** The display name of this node, if it has one, else NULL */
+		const gchar* displayName;
 
-	/** The length of this node's value in the frame */
-	guint _length;
-
-	/** The byte offset of this node's value in the frame */
-	guint _position;
+		/** THe raw binary value of this node if it has one, else NULL */
+		const guchar* value;
 
-	/** True if this is a protocol node; false if it's a field node */
-	gboolean _isProtocol;
+		/** The display value of this node or NULL */
+		const gchar* displayValue;
+	};
 
-	/** THe ordinal position of this field within the packet */
-	guint _ordinal;
+	/** Gets the node's Details, allocating them if need be */
+	Details& getDetails();
 
 	/** THe wireshark proto_node object that this object wraps */
 	proto_node* _node;
 
-	epan_dissect_t* _edt;
+	/** The name of this node, like 'tcp' or 'wlan.bssid' */
+	const gchar* _name;
 
 	ProtocolTreeNode* _parentNode;
 
-	/** The Ruby Packet object from which this node came.  Used only to create a ruby Field object for this node */
-	VALUE _packet;
+	ProtocolTreeNode* _nextWithSameName;
 
 	/** If a Ruby Field object has been created to wrap this node, it's stored here, else Qnil */
 	VALUE _fieldObject;
 
-	/** The buffer which will store the node's display name if it's not embedded in the frame buffer data */
-	gchar _displayNameBuffer[ITEM_LABEL_LENGTH];
+	ProtocolTreeNodeContext* _context;
+
+	/** NULL until something in it is computed */
+	Details* _details;
+
+	/** THe ordinal position of this field within the packet */
+	guint _ordinal;
+
+	/** The length of this node's value in the frame */
+	guint _length;
+
+	/** The byte offset of this node's value in the frame */
+	guint _position;
+
+	/** Some combination of the Flags */
+	guint _flags;
 
 	const guchar* getValueForField(field_info* fi);
 };
@@ -0,0 +1,48 @@
+#include "RecordReader.h"
+
+RecordReader::RecordReader(void)
+{
+}
+
+RecordReader::~RecordReader(void)
+{
+}
+
+WtapRecordReader::WtapRecordReader(wtap* wth)
+{
+	_wth = wth;
+	_shortRead = false;
+}
+
+WtapRecordReader::~WtapRecordReader(void)
+{
+}
+
+gboolean WtapRecordReader::readNext(RawRecord& record, int* err, gchar** errInfo) {
+	gint64 dataOffset = 0;
+
+	*err = 0;
+	if (!::wtap_read(_wth, err, errInfo, &dataOffset)) {
+		_shortRead = (*err == WTAP_ERR_SHORT_READ);
+		return FALSE;
+	} else if (*err != 0) {
+		//Something amiss
+		return FALSE;
+	}
+
+	record.phdr = ::wtap_phdr(_wth);
+	record.pseudoHeader = ::wtap_pseudoheader(_wth);
+	record.data = ::wtap_buf_ptr(_wth);
+	record.offset = dataOffset;
+
+	return TRUE;
+}
+
+bool WtapRecordReader::refresh() {
+	if (_shortRead) {
+		return false;
+	}
+
+	::wtap_cleareof(_wth);
+	return true;
+}
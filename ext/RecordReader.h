@@ -0,0 +1,84 @@
+#pragma once
+
+#include "RubyAndShit.h"
+
+/** A single raw capture record, as read from a capture file but not yet dissected.  The pointers
+ *  are owned by the RecordReader that produced the record, and remain valid only until the next
+ *  call to readNext on that reader */
+struct RawRecord {
+	/** The record's wiretap packet header (timestamp, lengths, encapsulation) */
+	const struct wtap_pkthdr* phdr;
+
+	/** The encapsulation-specific pseudo header passed to the dissectors */
+	union wtap_pseudo_header* pseudoHeader;
+
+	/** The captured frame data; phdr->caplen bytes long */
+	const guchar* data;
+
+	/** The offset within the capture file of this record, suitable for wtap_seek_read */
+	gint64 offset;
+};
+
+/** Where a sequential pass through a capture file has got to.  This is the state that has to carry over
+ *  from one frame to the next, and that a checkpoint saves */
+struct ReadPosition {
+	/** The total length of all the frames read so far, which fillInFdata records in each frame */
+	guint32 cumBytes;
+
+	/** The offset of the last record read, or -1 if none has been */
+	gint64 lastRecordOffset;
+};
+
+/** Abstract base class for the sources of raw capture records that CapFile dissects */
+class RecordReader
+{
+public:
+	RecordReader(void);
+	virtual ~RecordReader(void);
+
+	/** Reads the next record into 'record'.  Returns FALSE at the end of the capture, in which case *err is 0,
+	or when an error occurs, in which case *err is a WTAP_ERR_* value or errno and *errInfo may
+	be set to a g_malloc'd string describing the error */
+	virtual gboolean readNext(RawRecord& record, int* err, gchar** errInfo) = 0;
+
+	/** Returns true if the data of a record stays valid after subsequent records are read (though not
+	across a call to refresh()), which lets callers that keep several packets alive at once avoid copying
+	each frame */
+	virtual bool isRecordDataStable() const { return false; }
+
+	/** Positions the reader so the next record read is the one at 'offset', as previously reported in
+	RawRecord::offset.  Returns false if this reader can't seek, in which case its position is unchanged */
+	virtual bool seek(gint64 /* offset */) { return false; }
+
+	/** Called after readNext has reported the end of the file, or a record cut short at the end of the file,
+	to pick up whatever has been appended to the file since.  Returns false if the reader can't carry on
+	from where it stopped */
+	virtual bool refresh() { return false; }
+
+private:
+	//No copy ctor, and no assignment
+	RecordReader(const RecordReader&);
+	RecordReader& operator=(const RecordReader&);
+};
+
+/** The default RecordReader, which reads records sequentially with wtap_read.  Supports every file
+ *  format wiretap understands, at the cost of copying each record into the wiretap buffer */
+class WtapRecordReader : public RecordReader
+{
+public:
+	WtapRecordReader(wtap* wth);
+	virtual ~WtapRecordReader(void);
+
+	virtual gboolean readNext(RawRecord& record, int* err, gchar** errInfo);
+
+	/** Clears wiretap's EOF state so reading can continue, which works as long as the last read stopped
+	on a record boundary.  Wiretap can't back up over a partial record, so that can't be resumed */
+	virtual bool refresh();
+
+private:
+	/** The wiretap handle; owned by the capture_file, not by this reader */
+	wtap* _wth;
+
+	/** True if the last read stopped part-way through a record */
+	bool _shortRead;
+};
@@ -9,22 +9,28 @@ dir_config("wiretap")
 $CFLAGS += " -DINET6 -D_U_=\"__attribute__((unused))\""
 $CPPFLAGS += " -DINET6 -D_U_=\"__attribute__((unused))\""
 
-
-if (enable_config("lookaside-lists"))
-    $CFLAGS += " -DUSE_LOOKASIDE_LIST"
-    $CPPFLAGS += " -DUSE_LOOKASIDE_LIST"
-end
-
 unless PKGConfig.have_package('gtk+-2.0')
     warn("Unable to locate GTK+ version 2.0 or later")
     exit
 end
 
+# Records are read ahead on a background thread
+unless PKGConfig.have_package('gthread-2.0')
+    warn("Unable to locate gthread-2.0")
+    exit
+end
+
 unless have_header("glib.h")
     warn("Unable to locate glib.h; check the glib include directory and try again")
     exit
 end
 
+# Field queries compile Regexps with GRegex, which glib has had since 2.14
+unless have_func("g_regex_new", "glib.h")
+    warn("glib has no GRegex; glib 2.14 or later is required")
+    exit
+end
+
 has_stdarg = have_header("stdarg.h")
 unless has_stdarg
     warn("Unable to locate stdarg.h; varargs.h will be used instead, which may not work with later GCC versions")
@@ -38,6 +44,18 @@ if has_stdarg
     $CPPFLAGS += " -DHAVE_STDARG_H"
 end
 
+# Capture files are memory-mapped where the platform supports it; otherwise everything goes through wiretap
+have_header("sys/mman.h")
+
+# Capture filters are compiled and run with libpcap (WinPcap on Windows); without it set_capture_filter
+# raises.  have_library defines HAVE_LIBPCAP, as wireshark's own configure does
+unless have_library("pcap", "pcap_open_dead", "pcap.h") || have_library("wpcap", "pcap_open_dead", "pcap.h")
+    warn("Unable to locate libpcap; capture filters will not be available")
+end
+
+# Growing capture files are followed with inotify where it's available, and by polling otherwise
+have_header("sys/inotify.h")
+
 unless have_header("config.h" )
     warn("Unable to locate wireshark's config.h header; check the wireshark include directory")
     exit
@@ -2,8 +2,9 @@
 require 'rcapdissector'
 
 module CapDissector
-    # Internal exception thrown by the native FieldQuery object when a query predicate is found to not
-    # match the current field.  This error should never propagate to callers of this extension
+    # Internal exception once thrown by the native FieldQuery object when a query predicate was found to not
+    # match the current field.  The predicates now return true or false instead, so nothing raises it any more;
+    # it's kept so code that rescues it still loads
     class FieldDoesNotMatchQueryError < Exception
         def initialize(dontCare)
         end
@@ -9,6 +9,7 @@
 #include "NativePacket.h"
 #include "Field.h"
 #include "FieldQuery.h"
+#include "CompiledFieldQuery.h"
 #include "NativePointer.h"
 #include "Blob.h"
 
@@ -16,6 +17,7 @@ VALUE g_packet_class;
 VALUE g_protocol_class;
 VALUE g_field_class;
 VALUE g_field_query_class;
+VALUE g_compiled_field_query_class;
 VALUE g_blob_class;
 VALUE g_capfile_error_class;
 VALUE g_wtapcapfile_error_class;
@@ -26,6 +28,7 @@ VALUE g_at_func;
 
 VALUE g_cap_dissector_module;
 VALUE g_cap_file_class;
+VALUE g_cap_file_set_class;
 VALUE g_native_pointer_class;
 
 ID g_id_call;
@@ -49,9 +52,11 @@ extern "C" void Init_rcapdissector() {
 
 	//Define the CapFile class
 	g_cap_file_class = CapFile::createClass();
+	g_cap_file_set_class = CapFile::createSetClass();
 	g_packet_class = Packet::createClass();
 	g_field_class = Field::createClass();
 	g_field_query_class = FieldQuery::createClass();
+	g_compiled_field_query_class = CompiledFieldQuery::createClass();
 	g_native_pointer_class = NativePointer::createClass();
 	g_blob_class = Blob::createClass();
 
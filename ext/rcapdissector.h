@@ -10,6 +10,7 @@ extern VALUE g_packet_class;
 extern VALUE g_protocol_class;
 extern VALUE g_field_class;
 extern VALUE g_field_query_class;
+extern VALUE g_compiled_field_query_class;
 extern VALUE g_blob_class;
 extern VALUE g_capfile_error_class;
 extern VALUE g_wtapcapfile_error_class;
@@ -20,6 +21,7 @@ extern VALUE g_at_func;
 
 extern VALUE g_cap_dissector_module;
 extern VALUE g_cap_file_class;
+extern VALUE g_cap_file_set_class;
 extern VALUE g_native_pointer_class;
 
 extern ID g_id_call;
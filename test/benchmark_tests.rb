@@ -1,6 +1,7 @@
 require 'test/unit'
 require 'benchmark'
 require 'yaml'
+require 'tmpdir'
 
 require 'rcapdissector'
 require File.dirname(__FILE__) + '/testdata'
@@ -34,5 +35,179 @@ class PacketTests < Test::Unit::TestCase
             capfile = nil
         end
     end
-end
 
+    def test_filter_first_performance
+        #Compare dissecting every packet in full before filtering with filtering on a minimal tree first
+        bm(20) do |x|
+            [false, true].each do |filter_first|
+                x.report("filter_first=#{filter_first}") do
+                    capfile = CapDissector::CapFile.new(HUGE_CAP)
+                    capfile.set_display_filter('http.request', :filter_first => filter_first)
+
+                    capfile.each_packet() do |packet|
+                    end
+
+                    capfile.close
+                end
+            end
+        end
+    end
+
+    def test_node_footprint
+        #Walk every field of every packet by name, which touches each node but none of the lazily computed
+        #strings, and see what that costs in time, resident memory and cache misses.  Each walk runs in its
+        #own process, so the builds don't share a heap; set RCAPDISSECTOR_BASELINE to a directory holding an
+        #rcapdissector.so built from an older tree to compare that build's node layout with this one's
+        builds = [['current', nil]]
+        builds << ['baseline', ENV['RCAPDISSECTOR_BASELINE']] if ENV['RCAPDISSECTOR_BASELINE']
+
+        builds.each do |label, ext_dir|
+            result = walk_fields_in_child(ext_dir)
+            assert_not_nil(result, "The #{label} walk failed")
+
+            puts "#{label}: #{result[:fields]} fields in #{'%.2f' % result[:seconds]}s"
+            puts "#{label}: resident set grew by #{result[:rss_growth]} KB" if result[:rss_growth]
+            puts "#{label}: #{result[:cache_misses]} cache misses" if result[:cache_misses]
+        end
+    end
+
+    WALK_FIELDS_SCRIPT = <<-'EOS'
+        def rss
+            File.read('/proc/self/status') =~ /^VmRSS:\s+(\d+)/ ? $1.to_i : -1 rescue -1
+        end
+
+        rss_before = rss
+        started = Time.now
+        capfile = CapDissector::CapFile.new(ARGV[0])
+        fields = 0
+
+        capfile.each_packet() do |packet|
+            packet.each_field do |field|
+                fields += 1 if field.name
+            end
+        end
+
+        capfile.close
+        puts "#{fields} #{Time.now - started} #{rss_before < 0 ? -1 : rss - rss_before}"
+    EOS
+
+    def walk_fields_in_child(ext_dir)
+        #Runs WALK_FIELDS_SCRIPT in a new ruby, loading the extension from ext_dir ahead of the usual load path,
+        #under perf stat where perf is available.  Returns nil if the child fails
+        load_path = ($:.dup.unshift(ext_dir)).compact.map {|dir| "-I\"#{dir}\""}.join(' ')
+        script = File.join(Dir.tmpdir, "walk_fields_#{$$}.rb")
+        perf_output = File.join(Dir.tmpdir, "walk_fields_#{$$}.perf")
+        File.open(script, 'w') {|file| file.write(WALK_FIELDS_SCRIPT)}
+
+        command = "ruby #{load_path} -rrcapdissector \"#{script}\" \"#{HUGE_CAP}\""
+        perf = system('perf --version > /dev/null 2>&1')
+        command = "perf stat -x, -e cache-misses -o \"#{perf_output}\" #{command}" if perf
+
+        output = `#{command}`
+        return nil unless $?.success? && output =~ /^(\d+) ([\d.e-]+) (-?\d+)$/
+
+        result = {:fields => $1.to_i, :seconds => $2.to_f, :rss_growth => ($3.to_i < 0 ? nil : $3.to_i)}
+        if perf && File.exist?(perf_output)
+            File.read(perf_output) =~ /^(\d+),[^,]*,cache-misses/
+            result[:cache_misses] = $1.to_i if $1
+        end
+        result
+    ensure
+        File.delete(script) if script && File.exist?(script)
+        File.delete(perf_output) if perf_output && File.exist?(perf_output)
+    end
+
+    def test_field_match_performance
+        #Name lookups and SMB transactions produce packets with many repeated fields, which is where
+        #yielding matches in ordinal order without re-sorting them pays off
+        bm(30) do |x|
+            [['each_field', lambda {|packet| packet.each_field('dns.qry.name') {|field|}}],
+             ['each_field_match', lambda {|packet| packet.each_field_match(Proc.new {|query| query.name_is?('smb.cmd') || query.name_is?('dns.resp.name')}) {|field|}}],
+             ['each_descendant_field', lambda {|packet| packet.each_root_field {|root| packet.each_descendant_field(root) {|field|}}}]].each do |label, walk|
+                x.report(label) do
+                    capfile = CapDissector::CapFile.new(DNS_SMB_CAP)
+
+                    capfile.each_packet() do |packet|
+                        walk.call(packet)
+                    end
+
+                    capfile.close
+                end
+            end
+        end
+    end
+
+    def test_field_query_performance
+        #Compare a query proc, which Ruby calls with a FieldQuery for each field and whose predicates return
+        #true or false, with the same query compiled and evaluated natively
+        queries = [['proc', Proc.new {|query| query.name_is?('http.request.method') && query.sibling_name_is?('http.request.uri')}],
+                   ['compiled', CapDissector::FieldQuery.compile(:name => 'http.request.method', :sibling_name => 'http.request.uri')]]
+        matches = {}
+
+        bm(20) do |x|
+            queries.each do |label, query|
+                x.report(label) do
+                    capfile = CapDissector::CapFile.new(TEST_CAP)
+                    matches[label] = 0
+
+                    capfile.each_packet() do |packet|
+                        packet.each_field_match(query) {|field| matches[label] += 1}
+                    end
+
+                    capfile.close
+                end
+            end
+        end
+
+        assert_equal(matches['proc'], matches['compiled'])
+    end
+
+    def test_pattern_match_performance
+        #Compare matching display values with a Ruby regex, which needs a Field object and a Ruby string for
+        #every field, with the natively compiled pattern, from a query proc and from a compiled query
+        queries = [['ruby_regex', Proc.new {|query| query.get_field.display_value =~ /\.(com|net)$/ ? true : false}],
+                   ['display_value_matches?', Proc.new {|query| query.display_value_matches?(/\.(com|net)$/)}],
+                   ['compiled', CapDissector::FieldQuery.compile(:display_value_matches => /\.(com|net)$/)]]
+        matches = {}
+
+        bm(25) do |x|
+            queries.each do |label, query|
+                x.report(label) do
+                    capfile = CapDissector::CapFile.new(TEST_CAP)
+                    matches[label] = 0
+
+                    capfile.each_packet() do |packet|
+                        packet.each_field_match(query) {|field| matches[label] += 1}
+                    end
+
+                    capfile.close
+                end
+            end
+        end
+
+        assert_equal(1, matches.values.uniq.length)
+    end
+
+    def test_dissection_context_reuse
+        #Each dissection used to allocate and free its own epan_dissect_t; count how many the pool saves
+        capfile = CapDissector::CapFile.new(HUGE_CAP)
+        packets = 0
+
+        bm(20) do |x|
+            x.report("each_packet") do
+                capfile.each_packet() do |packet|
+                    packets += 1
+                end
+            end
+        end
+
+        stats = capfile.dissection_context_stats
+        capfile.close
+
+        saved = stats[:acquired] - stats[:allocated]
+        puts "#{packets} packets, #{stats[:acquired]} dissections, #{stats[:allocated]} contexts allocated"
+        puts "#{(saved * 1_000_000 / [stats[:acquired], 1].max)} epan_dissect_t allocations saved per million dissections"
+
+        assert(stats[:allocated] <= stats[:acquired])
+    end
+end
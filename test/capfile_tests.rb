@@ -1,4 +1,5 @@
 require 'test/unit'
+require 'fileutils'
 
 require 'rcapdissector'
 require File.dirname(__FILE__) + '/testdata'
@@ -100,6 +101,143 @@ class CapfileTests < Test::Unit::TestCase
         assert_equal(num_ip_packets, num_filtered_packets)
     end
 
+    def test_set_capture_filter
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        tcp_numbers = []
+        capfile.each_packet do |packet|
+            tcp_numbers << packet.number unless packet.find_first_field('tcp') == nil
+        end
+        capfile.close
+        assert_equal(true, tcp_numbers.length > 0)
+
+        # Rejected frames are never dissected, but still count towards the frame numbers
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.set_capture_filter('tcp')
+
+        filtered_numbers = []
+        capfile.each_packet do |packet|
+            filtered_numbers << packet.number
+        end
+        capfile.close
+
+        assert_equal(tcp_numbers, filtered_numbers)
+    end
+
+    def test_set_bogus_capture_filter
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+
+        assert_raise(CapDissector::CapFileError) do
+            capfile.set_capture_filter("wtf does this do?")
+        end
+
+        capfile.close
+    end
+
+    def test_filter_first
+        numbers = []
+        capfile = CapDissector::CapFile.new(HUGE_CAP)
+        capfile.set_display_filter('tcp.port == 80')
+        capfile.each_packet do |packet|
+            numbers << packet.number
+        end
+        capfile.close
+        assert_equal(true, numbers.length > 0)
+
+        # Filtering on a minimal tree first must pass exactly the same packets, fully dissected
+        filter_first_numbers = []
+        capfile = CapDissector::CapFile.new(HUGE_CAP)
+        capfile.set_display_filter('tcp.port == 80', :filter_first => true)
+        capfile.each_packet do |packet|
+            filter_first_numbers << packet.number
+            assert_not_nil(packet.find_first_field('frame'))
+            assert_not_nil(packet.find_first_field('tcp.srcport'))
+        end
+        capfile.close
+
+        assert_equal(numbers, filter_first_numbers)
+    end
+
+    def test_interested_fields
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        expected = []
+        capfile.each_packet do |packet|
+            port = packet.find_first_field('tcp.srcport')
+            expected << (port == nil ? nil : port.display_value)
+        end
+        capfile.close
+
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.interested_fields = ['tcp.srcport']
+        assert_equal(['tcp.srcport'], capfile.interested_fields)
+
+        actual = []
+        capfile.each_packet do |packet|
+            port = packet.find_first_field('tcp.srcport')
+            actual << (port == nil ? nil : port.display_value)
+
+            unless port == nil
+                # The nodes above an interesting field are still there, but nothing else is
+                assert_equal('tcp', port.parent.name)
+                assert_equal(nil, packet.find_first_field('tcp.dstport'))
+            end
+        end
+        capfile.close
+
+        assert_equal(expected, actual)
+
+        # Anything that converts to a String will do as a field name
+        name = Object.new
+        def name.to_str
+            'tcp.srcport'
+        end
+
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.interested_fields = [name]
+        actual = []
+        capfile.each_packet do |packet|
+            port = packet.find_first_field('tcp.srcport')
+            actual << (port == nil ? nil : port.display_value)
+        end
+        capfile.close
+
+        assert_equal(expected, actual)
+
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        assert_raise(ArgumentError) do
+            capfile.interested_fields = ['no.such.field']
+        end
+        capfile.close
+    end
+
+    def test_columns
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.columns = [:protocol, 'ip.src']
+        capfile.each_packet do |packet|
+            assert_not_nil(packet.protocol)
+            assert_equal(packet.protocol, packet.column(:protocol))
+            assert_nil(packet.info)
+
+            ip_src = packet.find_first_field('ip.src')
+            assert_not_nil(packet.column('ip.src')) unless ip_src == nil
+        end
+        capfile.close
+
+        # With no columns at all, the tree is still there
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.columns = []
+        capfile.each_packet do |packet|
+            assert_nil(packet.protocol)
+            assert_not_nil(packet.find_first_field('frame'))
+        end
+        capfile.close
+
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        assert_raise(ArgumentError) do
+            capfile.columns = [:no_such_column]
+        end
+        capfile.close
+    end
+
     def test_decrypt_test
         # Start with decryption disabled
         CapDissector::CapFile.set_wlan_decryption_keys nil
@@ -150,6 +288,612 @@ class CapfileTests < Test::Unit::TestCase
         assert_equal(false, num_ip_packets > 0)
     end
 
+    def test_each_packet_batch
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        summaries = []
+        capfile.each_packet do |packet|
+            summaries << [packet.number, packet.source_address, packet.protocol, packet.info]
+        end
+        capfile.close
+
+        [1, 7, CapDissector::CapFile::DEFAULT_PACKET_BATCH_SIZE].each do |batch_size|
+            capfile = CapDissector::CapFile.new(TEST_CAP)
+            batch_summaries = []
+            capfile.each_packet_batch(batch_size) do |batch|
+                assert_equal(true, batch.length > 0)
+                assert_equal(true, batch.length <= batch_size)
+
+                # Every packet in the batch must report its own columns, not those of the last packet dissected
+                batch.each do |packet|
+                    batch_summaries << [packet.number, packet.source_address, packet.protocol, packet.info]
+                end
+            end
+            capfile.close
+
+            assert_equal(summaries, batch_summaries)
+        end
+    end
+
+    def test_each_packet_batch_frame_data
+        # Each packet's lazily read values come from its frame data, which must stay put until the batch is
+        # done with, both when it's read out of a memory mapping and when it's read through wiretap
+        [false, true].each do |modified|
+            batch_cap = TEST_DATA_DIR + 'batch_udp.pcap'
+            write_udp_pcap(batch_cap, 20, modified)
+
+            begin
+                capfile = CapDissector::CapFile.new(batch_cap)
+                assert_equal(!modified, capfile.memory_mapped?) unless RUBY_PLATFORM =~ /mswin|mingw/
+
+                payloads = []
+                capfile.each_packet do |packet|
+                    payloads << packet.find_first_field('data').value
+                end
+                capfile.close
+                assert_equal((1..20).map {|number| "frame #{number}"}, payloads)
+
+                capfile = CapDissector::CapFile.new(batch_cap)
+                batch_payloads = []
+                capfile.each_packet_batch(7) do |batch|
+                    batch.each do |packet|
+                        batch_payloads << packet.find_first_field('data').value
+                    end
+                end
+                capfile.close
+
+                assert_equal(payloads, batch_payloads)
+            ensure
+                File.delete(batch_cap) if File.exist?(batch_cap)
+            end
+        end
+    end
+
+    def test_each_packet_batch_bogus_size
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+
+        assert_raise(ArgumentError) do
+            capfile.each_packet_batch(0) do |batch|
+            end
+        end
+    end
+
+    def test_memory_mapped
+        capfile = CapDissector::CapFile.new(WEP_ENCRYPTED_CAP)
+
+        # Whether the file can be mapped depends on the platform, but either way the packets must be the same
+        assert_equal(true, capfile.memory_mapped? == true || capfile.memory_mapped? == false)
+
+        num_packets = 0
+        capfile.each_packet do |packet|
+            num_packets += 1
+            assert_equal(num_packets, packet.number)
+        end
+        assert_equal(true, num_packets > 0)
+
+        capfile.close
+        assert_equal(false, capfile.memory_mapped?)
+    end
+
+    def test_read_ahead
+        summaries = {}
+
+        [0, 1, 3, CapDissector::CapFile::DEFAULT_READ_AHEAD_DEPTH].each do |depth|
+            CapDissector::CapFile.set_read_ahead_depth(depth)
+
+            begin
+                capfile = CapDissector::CapFile.new(HTTP_SEGMENTED_RESPONSE_CAP)
+                summaries[depth] = []
+                capfile.each_packet do |packet|
+                    summaries[depth] << [packet.number, packet.source_address, packet.protocol, packet.info]
+                end
+                capfile.close
+            ensure
+                CapDissector::CapFile.set_read_ahead_depth(CapDissector::CapFile::DEFAULT_READ_AHEAD_DEPTH)
+            end
+        end
+
+        # Reading ahead must never change which frames are seen or in what order
+        assert_equal(true, summaries[0].length > 0)
+        summaries.each_value do |summary|
+            assert_equal(summaries[0], summary)
+        end
+    end
+
+    def test_bogus_read_ahead_depth
+        assert_raise(ArgumentError) do
+            CapDissector::CapFile.set_read_ahead_depth(-1)
+        end
+    end
+
+    def test_packet_at
+        sidecar = TEST_CAP + '.rcapidx'
+        File.delete(sidecar) if File.exist?(sidecar)
+
+        begin
+            check_packet_at(sidecar)
+        ensure
+            File.delete(sidecar) if File.exist?(sidecar)
+        end
+    end
+
+    def check_packet_at(sidecar)
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        addresses = []
+        capfile.each_packet do |packet|
+            addresses << [packet.number, packet.source_address, packet.destination_address]
+        end
+        assert_equal(true, addresses.length >= 4)
+
+        # The index is built the first time a frame is asked for
+        packet = capfile.packet_at(3)
+        assert_equal(addresses[2], [packet.number, packet.source_address, packet.destination_address])
+        assert_equal(nil, capfile.packet_at(addresses.length + 1))
+
+        assert_raise(ArgumentError) do
+            capfile.packet_at(0)
+        end
+
+        ranged = []
+        capfile.each_packet(:range => 2..4) do |packet|
+            ranged << [packet.number, packet.source_address, packet.destination_address]
+        end
+        assert_equal(addresses[1..3], ranged)
+
+        ranged = []
+        capfile.each_packet(:range => (addresses.length - 1)...(addresses.length + 10)) do |packet|
+            ranged << [packet.number, packet.source_address, packet.destination_address]
+        end
+        assert_equal(addresses[-2..-1], ranged)
+        capfile.close
+
+        # Nothing is written next to the capture unless it's asked for
+        assert_equal(false, File.exist?(sidecar))
+
+        # Random access doesn't need a sequential pass first
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        packet = capfile.packet_at(addresses.length)
+        assert_equal(addresses.last, [packet.number, packet.source_address, packet.destination_address])
+        capfile.close
+        assert_equal(false, File.exist?(sidecar))
+
+        # Once asked for, the index is built by the sequential pass and saved alongside the capture
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.save_frame_index = true
+        capfile.each_packet do |packet|
+        end
+        capfile.close
+        assert_equal(true, File.exist?(sidecar))
+
+        # A new CapFile loads it
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        packet = capfile.packet_at(addresses.length)
+        assert_equal(addresses.last, [packet.number, packet.source_address, packet.destination_address])
+        capfile.close
+    end
+
+    def test_packet_at_columns
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        columns = []
+        capfile.each_packet do |packet|
+            columns << [packet.source_address, packet.destination_address, packet.protocol, packet.info]
+        end
+        assert_equal(true, columns.length >= 2)
+        assert_not_equal(columns[0], columns[1])
+
+        # Each packet's columns are its own, even after another frame has been dissected
+        first = capfile.packet_at(1)
+        second = capfile.packet_at(2)
+        assert_equal(columns[0], [first.source_address, first.destination_address, first.protocol, first.info])
+        assert_equal(columns[1], [second.source_address, second.destination_address, second.protocol, second.info])
+        capfile.close
+    end
+
+    def test_frame_columns
+        # The number and time columns are filled in from the frame's own data when they're first read, which
+        # for packet_at and batches is well after the packet was dissected
+        columns_cap = TEST_DATA_DIR + 'columns_udp.pcap'
+        write_udp_pcap(columns_cap, 10)
+
+        begin
+            capfile = CapDissector::CapFile.new(columns_cap)
+            columns = []
+            capfile.each_packet do |packet|
+                columns << [packet.column(:number), packet.timestamp]
+            end
+            assert_equal((1..10).map {|number| number.to_s}, columns.map {|number, timestamp| number})
+            assert_equal(10, columns.map {|number, timestamp| timestamp}.uniq.length)
+
+            10.downto(1) do |number|
+                packet = capfile.packet_at(number)
+                assert_equal(columns[number - 1], [packet.column(:number), packet.timestamp])
+            end
+            capfile.close
+
+            capfile = CapDissector::CapFile.new(columns_cap)
+            batch_columns = []
+            capfile.each_packet_batch(3) do |batch|
+                batch.each do |packet|
+                    batch_columns << [packet.column(:number), packet.timestamp]
+                end
+            end
+            assert_equal(columns, batch_columns)
+            capfile.close
+        ensure
+            File.delete(columns_cap) if File.exist?(columns_cap)
+        end
+    end
+
+    def test_packet_at_memory_mapped
+        mapped_cap = TEST_DATA_DIR + 'mapped_udp.pcap'
+        write_udp_pcap(mapped_cap, 8)
+
+        begin
+            capfile = CapDissector::CapFile.new(mapped_cap)
+            assert_equal(true, capfile.memory_mapped?) unless RUBY_PLATFORM =~ /mswin|mingw/
+
+            sequential = []
+            capfile.each_packet do |packet|
+                sequential << [packet.number,
+                    packet.find_first_field('udp.srcport').display_value,
+                    packet.find_first_field('ip.dst').display_value]
+            end
+            assert_equal((1..8).map {|number| [number, (999 + number).to_s, "10.0.0.#{number}"]}, sequential)
+
+            # The offsets recorded by the mapped reader must be ones wtap_seek_read understands
+            sequential.reverse.each do |number, port, dst|
+                packet = capfile.packet_at(number)
+                assert_equal([number, port, dst], [packet.number,
+                    packet.find_first_field('udp.srcport').display_value,
+                    packet.find_first_field('ip.dst').display_value])
+            end
+            capfile.close
+        ensure
+            File.delete(mapped_cap) if File.exist?(mapped_cap)
+            File.delete(mapped_cap + '.rcapidx') if File.exist?(mapped_cap + '.rcapidx')
+        end
+    end
+
+    def test_each_packet_time_range
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+        numbers = []
+        capfile.each_packet do |packet|
+            numbers << packet.number
+        end
+        capfile.close
+
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        # Every frame in the capture is after the epoch and before the far future
+        windowed = []
+        capfile.each_packet(:from => Time.at(0), :to => Time.at(2**31 - 1), :warm_up => 5) do |packet|
+            windowed << packet.number
+        end
+        assert_equal(numbers, windowed)
+
+        windowed = []
+        capfile.each_packet(:from => Time.at(2**31 - 1)) do |packet|
+            windowed << packet.number
+        end
+        assert_equal([], windowed)
+
+        windowed = []
+        capfile.each_packet(:to => 0) do |packet|
+            windowed << packet.number
+        end
+        assert_equal([], windowed)
+
+        assert_raise(ArgumentError) do
+            capfile.each_packet(:from => Time.at(0), :warm_up => -1) do |packet|
+            end
+        end
+
+        assert_raise(ArgumentError) do
+            capfile.each_packet(:from => Time.at(0), :range => 1..2) do |packet|
+            end
+        end
+        capfile.close
+    end
+
+    def test_each_packet_time_range_interior
+        windowed_cap = TEST_DATA_DIR + 'windowed_udp.pcap'
+        write_udp_pcap(windowed_cap, 6)
+
+        begin
+            # The frames' own timestamps, as written to the file
+            timestamps = (1..6).map {|number| Time.at(1200000000 + number)}
+
+            capfile = CapDissector::CapFile.new(windowed_cap)
+
+            windowed = []
+            capfile.each_packet(:from => timestamps[2], :to => timestamps[4]) do |packet|
+                windowed << packet.number
+            end
+            assert_equal([3, 4, 5], windowed)
+
+            # Half way between frames, the window still only takes in the frames inside it
+            windowed = []
+            capfile.each_packet(:from => timestamps[1].to_f + 0.5, :to => timestamps[3].to_f + 0.5) do |packet|
+                windowed << packet.number
+            end
+            assert_equal([3, 4], windowed)
+
+            # Frames 1 and 2 are dissected to warm up the dissectors, but only the window is yielded
+            before = capfile.dissection_context_stats[:acquired]
+            windowed = []
+            capfile.each_packet(:from => timestamps[2], :to => timestamps[4], :warm_up => 2) do |packet|
+                windowed << packet.number
+            end
+            assert_equal([3, 4, 5], windowed)
+            assert_equal(5, capfile.dissection_context_stats[:acquired] - before)
+
+            # Without a warm up, only the window is dissected
+            before = capfile.dissection_context_stats[:acquired]
+            capfile.each_packet(:from => timestamps[2], :to => timestamps[4]) do |packet|
+            end
+            assert_equal(3, capfile.dissection_context_stats[:acquired] - before)
+
+            capfile.close
+        ensure
+            File.delete(windowed_cap) if File.exist?(windowed_cap)
+            File.delete(windowed_cap + '.rcapidx') if File.exist?(windowed_cap + '.rcapidx')
+        end
+    end
+
+    def test_checkpoint_resume
+        checkpoint = TEST_DATA_DIR + 'test.cap.checkpoint'
+        File.delete(checkpoint) if File.exist?(checkpoint)
+
+        begin
+            # Stop part-way through, as if the process had died; the last checkpoint is after frame 2
+            capfile = CapDissector::CapFile.new(TEST_CAP)
+            capfile.set_checkpoint_file(checkpoint, 2)
+            capfile.each_packet do |packet|
+                break if packet.number == 3
+            end
+            capfile.close
+            assert_equal(true, File.exist?(checkpoint))
+
+            # A new run picks up after the checkpoint, with the numbering intact
+            capfile = CapDissector::CapFile.new(TEST_CAP)
+            capfile.set_checkpoint_file(checkpoint, 2)
+            numbers = []
+            capfile.each_packet do |packet|
+                numbers << packet.number
+            end
+            capfile.close
+            assert_equal(3, numbers.first)
+            assert_equal((3..numbers.last).to_a, numbers)
+
+            # Once a run has finished, there's nothing left to do
+            capfile = CapDissector::CapFile.new(TEST_CAP)
+            capfile.set_checkpoint_file(checkpoint)
+            capfile.each_packet do |packet|
+                fail("Packet #{packet.number} was yielded after the checkpoint said the run was complete")
+            end
+            capfile.close
+
+            # A checkpoint from one capture can't be used to resume another
+            capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+            assert_raise(CapDissector::CapFileError) do
+                capfile.set_checkpoint_file(checkpoint)
+            end
+            capfile.close
+        ensure
+            File.delete(checkpoint) if File.exist?(checkpoint)
+        end
+    end
+
+    def test_checkpoint_resume_other_path
+        named_cap = File.expand_path(TEST_DATA_DIR + 'named_udp.pcap')
+        linked_cap = File.expand_path(TEST_DATA_DIR + 'linked_udp.pcap')
+        checkpoint = named_cap + '.checkpoint'
+        write_udp_pcap(named_cap, 6)
+
+        begin
+            capfile = CapDissector::CapFile.new(named_cap)
+            capfile.set_checkpoint_file(checkpoint, 2)
+            capfile.each_packet do |packet|
+                break if packet.number == 3
+            end
+            capfile.close
+
+            # The same capture, named relative to another working directory, resumes from the checkpoint
+            numbers = []
+            Dir.chdir(File.dirname(named_cap)) do
+                capfile = CapDissector::CapFile.new(File.basename(named_cap))
+                capfile.set_checkpoint_file(checkpoint)
+                capfile.each_packet do |packet|
+                    numbers << packet.number
+                end
+                capfile.close
+            end
+            assert_equal([3, 4, 5, 6], numbers)
+
+            # So does the same capture reached through a symbolic link
+            unless RUBY_PLATFORM =~ /mswin|mingw/
+                File.symlink(named_cap, linked_cap)
+                capfile = CapDissector::CapFile.new(linked_cap)
+                capfile.set_checkpoint_file(checkpoint)
+                capfile.each_packet do |packet|
+                    fail("Packet #{packet.number} was yielded after the checkpoint said the run was complete")
+                end
+                capfile.close
+            end
+        ensure
+            [named_cap, linked_cap, checkpoint].each do |path|
+                File.delete(path) if File.exist?(path) || File.symlink?(path)
+            end
+        end
+    end
+
+    def test_checkpoint_resume_while_indexing
+        indexed_cap = TEST_DATA_DIR + 'indexed_udp.pcap'
+        checkpoint = indexed_cap + '.checkpoint'
+        write_udp_pcap(indexed_cap, 6)
+
+        begin
+            capfile = CapDissector::CapFile.new(indexed_cap)
+            ports = []
+            capfile.each_packet do |packet|
+                ports << packet.find_first_field('udp.srcport').display_value
+            end
+            capfile.close
+
+            capfile = CapDissector::CapFile.new(indexed_cap)
+            capfile.set_checkpoint_file(checkpoint, 2)
+            capfile.each_packet do |packet|
+                break if packet.number == 3
+            end
+            capfile.close
+
+            # The reader building the index seeks to the checkpoint rather than reading up to it, which
+            # leaves a gap in what it's indexed, so the index must be rebuilt rather than saved with the gap
+            capfile = CapDissector::CapFile.new(indexed_cap)
+            capfile.save_frame_index = true
+            capfile.set_checkpoint_file(checkpoint, 2)
+            numbers = []
+            capfile.each_packet do |packet|
+                numbers << packet.number
+            end
+            assert_equal([3, 4, 5, 6], numbers)
+
+            1.upto(6) do |number|
+                packet = capfile.packet_at(number)
+                assert_equal(number, packet.number)
+                assert_equal(ports[number - 1], packet.find_first_field('udp.srcport').display_value)
+            end
+            capfile.close
+
+            capfile = CapDissector::CapFile.new(indexed_cap)
+            assert_equal(ports[5], capfile.packet_at(6).find_first_field('udp.srcport').display_value)
+            capfile.close
+        ensure
+            [indexed_cap, checkpoint, indexed_cap + '.rcapidx'].each do |path|
+                File.delete(path) if File.exist?(path)
+            end
+        end
+    end
+
+    def test_follow
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        memory_mapped = capfile.memory_mapped?
+        numbers = []
+        capfile.each_packet do |packet|
+            numbers << packet.number
+        end
+        capfile.close
+
+        growing_cap = TEST_DATA_DIR + 'growing.cap'
+        data = File.open(TEST_CAP, 'rb') { |f| f.read }
+
+        # Write the capture in thirds, most likely stopping part-way through a record each time.  Only
+        # the memory-mapped reader can pick up a partial record, so with wiretap stop between records
+        if memory_mapped
+            splits = [24 + (data.length - 24) / 3, 24 + 2 * (data.length - 24) / 3]
+        else
+            offsets = pcap_record_offsets(data)
+            splits = [offsets[offsets.length / 3], offsets[2 * offsets.length / 3]]
+        end
+        splits << data.length
+        File.open(growing_cap, 'wb') { |f| f.write(data[0, splits[0]]) }
+
+        begin
+            capfile = CapDissector::CapFile.new(growing_cap)
+
+            writer = Thread.new do
+                (1...splits.length).each do |idx|
+                    sleep 0.5
+                    File.open(growing_cap, 'ab') { |f| f.write(data[splits[idx - 1]...splits[idx]]) }
+                end
+            end
+
+            followed = []
+            capfile.each_packet(:follow => true, :idle_timeout => 2) do |packet|
+                followed << packet.number
+            end
+            writer.join
+            capfile.close
+
+            assert_equal(numbers, followed)
+        ensure
+            File.delete(growing_cap) if File.exist?(growing_cap)
+            File.delete(growing_cap + '.rcapidx') if File.exist?(growing_cap + '.rcapidx')
+        end
+    end
+
+    def test_capfile_set
+        expected = 0
+        SMALLISH_CAPS.each do |cap|
+            capfile = CapDissector::CapFile.new(cap)
+            capfile.each_packet do |packet|
+                expected += 1
+            end
+            capfile.close
+        end
+
+        capset = CapDissector::CapFileSet.new(SMALLISH_CAPS)
+        assert_equal(SMALLISH_CAPS, capset.capture_files)
+
+        numbers = []
+        last_timestamp = nil
+        capset.each_packet do |packet|
+            numbers << packet.number
+            assert(last_timestamp <= packet.timestamp, "Packets came out of timestamp order") unless last_timestamp.nil?
+            last_timestamp = packet.timestamp
+        end
+
+        assert_equal((1..expected).to_a, numbers)
+
+        assert_raise(CapDissector::CapFileError) do
+            capset.packet_at(1)
+        end
+
+        capset.close
+    end
+
+    def test_capfile_set_glob
+        capset = CapDissector::CapFileSet.new(TEST_DATA_DIR + 'test.ca?')
+        assert_equal([TEST_CAP], capset.capture_files)
+        capset.close
+
+        assert_raise(CapDissector::CapFileError) do
+            CapDissector::CapFileSet.new(TEST_DATA_DIR + '*.nosuchextension')
+        end
+    end
+
+    def test_capfile_set_directory
+        set_dir = TEST_DATA_DIR + 'capset'
+        FileUtils.rm_rf(set_dir)
+        Dir.mkdir(set_dir)
+
+        begin
+            caps = ['ring_1.pcap', 'ring_2.pcap'].map {|name| File.join(set_dir, name)}
+            caps.each {|cap| write_udp_pcap(cap, 2)}
+
+            # Index and checkpoint files, and the temporary files they're written to, aren't capture files
+            File.open(caps[0] + '.rcapidx', 'wb') {|f| f.write('index')}
+            File.open(caps[0] + '.rcapidx.tmp', 'wb') {|f| f.write('index')}
+            File.open(File.join(set_dir, 'progress'), 'w') {|f| f.write("rcapdissector checkpoint 1\n")}
+            File.open(File.join(set_dir, 'progress.tmp'), 'w') {|f| f.write("rcapdissector checkpoint 1\n")}
+
+            capset = CapDissector::CapFileSet.new(set_dir)
+            assert_equal(caps, capset.capture_files)
+            capset.close
+        ensure
+            FileUtils.rm_rf(set_dir)
+        end
+    end
+
+    def test_each_packet_after_close
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.close
+
+        assert_raise(CapDissector::CapFileError) do
+            capfile.each_packet do |packet|
+            end
+        end
+    end
+
     def test_openclose_leak
         # It seems I'm getting a significant leak with each capture file I open then close
         # See if that bears out in testing
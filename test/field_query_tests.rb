@@ -14,6 +14,10 @@ class FieldQueryTests < Test::Unit::TestCase
                 query.name_is?('quidgiebo')
             }
             assert_equal(false, match)
+
+            # Text items have no registered header field, but still have to match the name
+            match = packet.field_matches?(CapDissector::FieldQuery.compile(:name => 'quidgiebo'))
+            assert_equal(false, match)
         end
     end
 
@@ -50,6 +54,60 @@ class FieldQueryTests < Test::Unit::TestCase
         end
     end
 
+    def test_value_is_string
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            match = packet.field_matches? Proc.new { |query| 
+                query.value_is? "Host: online.wsj.com\r\n"
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches? Proc.new { |query| 
+                query.value_is? "Host: online.wsj.com"
+            }
+            assert_equal(false, match)
+        end
+    end
+
+    def test_value_starts_with
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            match = packet.field_matches? Proc.new { |query| 
+                query.value_starts_with? "Host: "
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches? Proc.new { |query| 
+                query.value_starts_with? [0x48, 0x6f, 0x73, 0x74, 0x3a]
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches? Proc.new { |query| 
+                query.value_starts_with? "online.wsj.com"
+            }
+            assert_equal(false, match)
+        end
+    end
+
+    def test_value_contains
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            match = packet.field_matches? Proc.new { |query| 
+                query.value_contains? "online.wsj.com"
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches?(CapDissector::FieldQuery.compile(:value_contains => "wsj.com\r\n"))
+            assert_equal(true, match)
+
+            match = packet.field_matches?(CapDissector::FieldQuery.compile(:value_contains => "online.nyt.com"))
+            assert_equal(false, match)
+        end
+    end
+
     def test_display_value_is_negative
         capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
 
@@ -94,6 +152,69 @@ class FieldQueryTests < Test::Unit::TestCase
         end
     end
 
+    def test_name_matches
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            match = packet.field_matches? Proc.new { |query| 
+                query.name_matches? 'http.request.*'
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches? Proc.new { |query| 
+                query.name_matches? /^TCP\.FLAGS\./i
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches? Proc.new { |query| 
+                query.name_matches? 'quidgiebo.*'
+            }
+            assert_equal(false, match)
+
+            names = []
+            packet.each_field_match(CapDissector::FieldQuery.compile(:name_matches => 'tcp.flags.*')) {|field| names << field.name}
+            assert(names.include?('tcp.flags.push'))
+            assert(names.all? {|name| name =~ /^tcp\.flags\./})
+        end
+    end
+
+    def test_display_value_matches
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            match = packet.field_matches? Proc.new { |query| 
+                query.display_value_matches? /Refresh\.html$/
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches? Proc.new { |query| 
+                query.display_value_matches? '/public/page/*.html'
+            }
+            assert_equal(true, match)
+
+            match = packet.field_matches?(CapDissector::FieldQuery.compile(:name => 'http.request.uri', :display_value_matches => /^\/private\//))
+            assert_equal(false, match)
+
+            # Patterns and values are matched as bytes, not UTF-8
+            match = packet.field_matches?(CapDissector::FieldQuery.compile(:display_value_matches => Regexp.new("\xff\xfe", nil, 'n')))
+            assert_equal(false, match)
+        end
+    end
+
+    def test_invalid_patterns
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        assert_raise(TypeError) do
+            CapDissector::FieldQuery.compile(:name_matches => 42)
+        end
+
+        capfile.each_packet() do |packet|
+            assert_raise(TypeError) do
+                packet.field_matches? Proc.new { |query| query.name_matches? 42 }
+            end
+        end
+    end
+
     def test_sibling_name_is_negative
         capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
 
@@ -207,5 +328,111 @@ class FieldQueryTests < Test::Unit::TestCase
             assert_equal(true, match)
         end
     end
-end
 
+    def test_predicates_return_booleans
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            results = []
+            packet.field_matches? Proc.new { |query|
+                results << query.name_is?('http.request.method') << query.display_value_is?('quidgiebo')
+                results << query.value_is?([0]) << query.sibling_name_is?('dickbob') << query.has_value?
+                false
+            }
+            assert(results.all? {|result| result == true || result == false})
+            assert(results.include?(true))
+        end
+    end
+
+    def test_method_as_query
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            assert_equal(true, packet.field_matches?(method(:http_request_method?)))
+        end
+    end
+
+    def http_request_method?(query)
+        query.name_is?('http.request.method')
+    end
+
+    def test_compiled_name_and_value
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            assert_equal(true, packet.field_matches?(CapDissector::FieldQuery.compile(:name => 'tcp.flags.push')))
+            assert_equal(false, packet.field_matches?(CapDissector::FieldQuery.compile(:name => 'quidgiebo')))
+
+            host = [0x48, 0x6f, 0x73, 0x74, 0x3a, 0x20, 0x6f, 0x6e, 0x6c, 0x69, 0x6e, 0x65, 0x2e, 0x77, 0x73, 0x6a, 0x2e, 0x63, 0x6f, 0x6d, 0x0d, 0x0a]
+            assert_equal(true, packet.field_matches?(CapDissector::FieldQuery.compile(:value => host)))
+            assert_equal(true, packet.field_matches?(CapDissector::FieldQuery.compile(:value => host.pack('C*'))))
+            assert_equal(false, packet.field_matches?(CapDissector::FieldQuery.compile(:value => [0xab, 0xcd, 0xef, 0x01, 0x23, 0x45, 0x67, 0x89])))
+        end
+    end
+
+    def test_compiled_sibling_matches
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            proc_match = packet.find_first_field_match(Proc.new { |query|
+                query.sibling_matches? Proc.new { |sib_query|
+                    sib_query.name_is? 'http.request.method'
+                }
+            })
+            compiled_match = packet.find_first_field_match(CapDissector::FieldQuery.compile(:sibling => {:name => 'http.request.method'}))
+            assert_not_nil(compiled_match)
+            assert_equal(proc_match.name, compiled_match.name)
+
+            assert_equal(false, packet.field_matches?(CapDissector::FieldQuery.compile(:sibling => {:name => 'fuck.tard'})))
+        end
+    end
+
+    def test_compiled_any_and_has
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            query = CapDissector::FieldQuery.compile(:any => [{:name => 'quidgiebo'}, {:name => 'http.request.method'}])
+            compiled_count = 0
+            packet.each_field_match(query) {|field| compiled_count += 1}
+            proc_count = 0
+            packet.each_field_match(Proc.new {|q| q.name_is?('quidgiebo') || q.name_is?('http.request.method')}) {|field| proc_count += 1}
+            assert_equal(proc_count, compiled_count)
+            assert_equal(true, packet.field_matches?(query))
+
+            assert_equal(true, packet.field_matches?(CapDissector::FieldQuery.compile(:has_value => false)))
+            assert_equal(true, packet.field_matches?(CapDissector::FieldQuery.compile(:has_display_name => true)))
+        end
+    end
+
+    def test_compiled_query_reused_across_packets
+        #The compiled query remembers what it learned about each kind of field, so one query used over
+        #several files must still select the same fields as the equivalent proc
+        compiled = CapDissector::FieldQuery.compile(:name => 'tcp', :has_display_value => false)
+        query_proc = Proc.new {|query| query.name_is?('tcp') && !query.has_display_value?}
+
+        SMALLISH_CAPS.each do |cap|
+            capfile = CapDissector::CapFile.new(cap)
+
+            capfile.each_packet() do |packet|
+                compiled_names = []
+                packet.each_field_match(compiled) {|field| compiled_names << field.name}
+                proc_names = []
+                packet.each_field_match(query_proc) {|field| proc_names << field.name}
+
+                assert_equal(proc_names, compiled_names)
+            end
+
+            capfile.close
+        end
+    end
+
+    def test_compile_rejects_unknown_conditions
+        assert_raise(ArgumentError) do
+            CapDissector::FieldQuery.compile(:name => 'http.request.method', :nmae => 'oops')
+        end
+
+        assert_raise(TypeError) do
+            CapDissector::FieldQuery.compile(:any => [:name])
+        end
+    end
+end
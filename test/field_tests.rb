@@ -127,6 +127,60 @@ class FieldTests < Test::Unit::TestCase
         end
     end
 
+    def test_hierarchy_with_interested_fields
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+        capfile.interested_fields = ['http.request.method']
+
+        capfile.each_packet() do |packet|
+            #Only the interesting field and its ancestors are wrapped, and they still link up
+            method = packet.find_first_field('http.request.method')
+            assert_not_nil(method)
+
+            root = method
+            root = root.parent while root.parent
+            assert_equal('http', root.name)
+
+            roots = []
+            packet.each_root_field do |field|
+                assert_nil(field.parent)
+                roots << field.name
+            end
+            assert_equal(['http'], roots)
+
+            children = []
+            root.each_child do |field|
+                assert_equal(root, field.parent)
+                children << field
+            end
+            assert(children.length > 0)
+            assert_nil(children.last.next_sibling)
+        end
+    end
+
+    def test_descendant_of
+        capfile = CapDissector::CapFile.new(SINGLE_HTTP_REQ_CAP)
+
+        capfile.each_packet() do |packet|
+            ip = packet.find_first_field('ip')
+            tcp = packet.find_first_field('tcp')
+            ip_src = packet.find_first_field('ip.src')
+
+            assert(ip_src.descendant_of?(ip))
+            assert(!ip_src.descendant_of?(tcp))
+            assert(!ip.descendant_of?(ip))
+            assert(!ip.descendant_of?(ip_src))
+
+            #Every descendant comes out in ordinal order, and is beneath the parent
+            last_ordinal = ip.ordinal
+            packet.each_descendant_field(ip) do |field|
+                assert(field.descendant_of?(ip))
+                assert(field.ordinal > last_ordinal)
+                last_ordinal = field.ordinal
+            end
+            assert(last_ordinal > ip.ordinal)
+        end
+    end
+
     def add_field_to_hash(field, hash)
         if hash[field.name] == nil
             hash[field.name] = []
@@ -19,6 +19,27 @@ class PacketTests < Test::Unit::TestCase
         assert_not_equal(0, count)
     end
 
+    def test_packet_outlives_capfile
+        # A packet left behind by a break, and one from packet_at, hold on to their dissection contexts after
+        # every reference to the CapFile is gone
+        packets = []
+        capfile = CapDissector::CapFile.new(TEST_CAP)
+        capfile.each_packet() do |packet|
+            packets << packet
+            break
+        end
+        packets << capfile.packet_at(2)
+        capfile = nil
+        GC.start
+
+        assert_equal([1, 2], packets.map {|packet| packet.number})
+        assert_not_nil(packets.last.find_first_field('frame'))
+
+        # Let the packets and the capture file go in the same collection
+        packets = nil
+        GC.start
+    end
+
     def test_load_time
         capfile = CapDissector::CapFile.new(TEST_CAP)
         count = 0
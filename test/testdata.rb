@@ -12,10 +12,53 @@ module TestData
     SINGLE_HTTP_REQ_CAP = TEST_DATA_DIR + 'single_http_request.cap'
     HTTP_SEGMENTED_RESPONSE_CAP = TEST_DATA_DIR + 'small_http_image_download.cap'
     WEP_ENCRYPTED_CAP = TEST_DATA_DIR + 'bradenton_wep.pcap'
+    DNS_SMB_CAP = TEST_DATA_DIR + 'dns_smb_traffic.pcap'
 
     SMALLISH_CAPS = [TEST_CAP, SINGLE_HTTP_REQ_CAP, HTTP_SEGMENTED_RESPONSE_CAP]
 
     WEP_ENCRYPTED_CAP_KEY = "6D0F9AD408"
     WEP_ENCRYPTED_CAP_INCORRECT_KEY = "5BB99DA271"
+
+    # The byte offsets at which each record of a classic pcap file starts, read from the record headers
+    def pcap_record_offsets(data)
+        magic = data[0, 4].unpack('V')[0]
+        length_format = case magic
+            when 0xa1b2c3d4, 0xa1b23c4d then 'V'
+            when 0xd4c3b2a1, 0x4d3cb2a1 then 'N'
+            else raise "Not a pcap file"
+        end
+
+        offsets = []
+        offset = 24
+        while offset + 16 <= data.length
+            offsets << offset
+            offset += 16 + data[offset + 8, 4].unpack(length_format)[0]
+        end
+        offsets
+    end
+
+    # Writes a classic little-endian Ethernet pcap of 'count' UDP frames, one second apart.  Frame n (1 based)
+    # is from port 999 + n to 10.0.0.n, and carries the payload "frame n", so every frame can be told apart by
+    # its fields.  A file like this is always eligible for the memory-mapped reader, unless 'modified' is set,
+    # in which case it's written in the modified (Kuznetzov) pcap format, which only wiretap reads
+    def write_udp_pcap(path, count, modified = false)
+        File.open(path, 'wb') do |f|
+            f.write([modified ? 0xa1b2cd34 : 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1].pack('VvvVVVV'))
+
+            1.upto(count) do |number|
+                payload = "frame #{number}"
+                udp = [999 + number, 9999, 8 + payload.length, 0].pack('nnnn') + payload
+                ip = [0x45, 0, 20 + udp.length, number, 0, 64, 17, 0].pack('CCnnnCCn') +
+                    [10, 0, 0, 254, 10, 0, 0, number].pack('C*')
+                frame = [0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x00, 0x66, 0x77, 0x88, 0x99, 0xaa].pack('C*') +
+                    [0x0800].pack('n') + ip + udp
+
+                f.write([1200000000 + number, 0, frame.length, frame.length].pack('VVVV'))
+                # The modified format adds the interface index, protocol, packet type and padding
+                f.write([0, 0x0800, 0, 0].pack('VvCC')) if modified
+                f.write(frame)
+            end
+        end
+    end
 end
 